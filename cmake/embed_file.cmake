@@ -0,0 +1,18 @@
+# Writes OUTPUT, a header holding the contents of INPUT as
+#   inline constexpr std::string_view NAME
+# Run as: cmake -DINPUT=... -DOUTPUT=... -DNAME=... -P embed_file.cmake
+file(READ "${INPUT}" content)
+string(FIND "${content}" ")embedded\"" clash)
+if(NOT clash EQUAL -1)
+    message(FATAL_ERROR "${INPUT} contains the raw string delimiter")
+endif()
+
+get_filename_component(source "${INPUT}" NAME)
+file(WRITE "${OUTPUT}.tmp"
+    "// Generated from ${source} at build time, do not edit\n"
+    "#pragma once\n"
+    "#include <string_view>\n\n"
+    "inline constexpr std::string_view ${NAME} = R\"embedded(${content})embedded\";\n")
+# Only touch the header when it changes, so dependents don't rebuild for nothing
+configure_file("${OUTPUT}.tmp" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,19 @@
+# Writes OUTPUT, a header holding a digest of every file in INPUTS as
+#   inline constexpr std::string_view NAME
+# Run as: cmake "-DINPUTS=a;b;..." -DOUTPUT=... -DNAME=... -P hash_sources.cmake
+set(digests "")
+foreach(input IN LISTS INPUTS)
+    file(SHA256 "${input}" digest)
+    get_filename_component(name "${input}" NAME)
+    string(APPEND digests "${name} ${digest}\n")
+endforeach()
+string(SHA256 digest "${digests}")
+
+file(WRITE "${OUTPUT}.tmp"
+    "// Generated at build time, do not edit\n"
+    "#pragma once\n"
+    "#include <string_view>\n\n"
+    "inline constexpr std::string_view ${NAME} = \"${digest}\";\n")
+# Only touch the header when it changes, so dependents don't rebuild for nothing
+configure_file("${OUTPUT}.tmp" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.tmp")
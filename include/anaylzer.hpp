@@ -1,10 +1,74 @@
 #pragma once
 #include "parser.hpp"
+#include "template.hpp"
 #include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+// What the analyzer hands to the code generator. The tree itself is never modified,
+// so one parsed tree can be analyzed and rendered again (-dev mode). Everything in
+// here lives in the Arena that was current during analyzeTree().
+//
+// Components are not copied per @load: a @save body is shared by all of its
+// instances, and its strings are compiled once against one SlotTable for the whole
+// page. The renderer walks the body and fills in the parameters as it writes.
+class Analysis {
+public:
+    // What a @load renders: the component body it names (nullptr if there is no such
+    // component) and its parameters, a repeated name keeping its last value. What an
+    // instance renders depends on nothing but the values of `reads` in its scope.
+    struct Instance {
+        const NodeList* body = nullptr;
+        std::vector<Binding> bindings;
+        const std::vector<uint32_t>* reads = nullptr; // sorted, set along with body
+    };
 
-inline std::unique_ptr<RootNode> analyzeTree(std::unique_ptr<RootNode> root) {
-    // TODO: Implement semantic analysis
-    
-    return root;
-}
+    // Body of a component (@save), or nullptr if no screen can reach it or it doesn't exist
+    const NodeList* component(Symbol name) const;
+
+    // The instance of a @load the page can show, or nullptr for any other @load
+    const Instance* instance(const LoadStmtNode& load) const;
+
+    // Compiled text of a @text, or header of a tag, inside a component body; nullptr
+    // for strings parameters can't reach (those of the page itself)
+    const TextTemplate* text(const ASTNode& node) const;
+
+    // The top-level statements to render: the tree's own, or a copy with the
+    // @const values folded in (and the declarations themselves dropped)
+    const NodeList& statements() const { return source ? *source : folded; }
+
+    // Every slot a reachable component's output takes from the scope it is loaded in,
+    // sorted: what its instances depend on. Slots that only its own nested @loads
+    // bind are not among them.
+    const std::vector<uint32_t>& parameters(Symbol component) const { return reads.at(component); }
+    // The placeholder name of a slot
+    Symbol placeholder(uint32_t slot) const { return slots.name(slot); }
+
+    // Reachable components, each after the ones it loads
+    const std::vector<Symbol>& order() const { return expansionOrder; }
+    // Components that were dropped because nothing can reach them
+    size_t unreachable() const { return dropped; }
+
+private:
+    friend Analysis analyzeTree(const RootNode& root);
+
+    const NodeList* source = nullptr;
+    NodeList folded{Arena::current().resource()};
+
+    SlotTable slots;
+    std::unordered_map<Symbol, const NodeList*> bodies;
+    std::unordered_map<const LoadStmtNode*, Instance> instances;
+    std::unordered_map<const ASTNode*, TextTemplate> strings;
+    // Every slot a component's output takes from its scope, through the components it loads too
+    std::unordered_map<Symbol, std::vector<uint32_t>> reads;
+    std::vector<Symbol> expansionOrder;
+    size_t dropped = 0;
+};
+
+// Folds the @const declarations into the page, then builds the @save/@load
+// dependency graph starting from the @loads outside of any component (in screens
+// or at the top level), rejects reachable cycles with a std::runtime_error that
+// spells out the loop, and compiles every reachable component exactly once. A
+// reachable component that loads one that doesn't exist is an error as well.
+Analysis analyzeTree(const RootNode& root);
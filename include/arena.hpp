@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Per-compilation memory. AST nodes, their child lists, decoded string literals and
+// everything the code generator clones or rewrites are bump-allocated from the
+// current Arena and released all at once when it dies; nothing is freed one by one.
+// Not thread-safe: every thread works in its own Arena (see Scope).
+class Arena {
+public:
+    explicit Arena(size_t initialSize = 64 * 1024);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &pool; }
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        return pool.allocate(size, alignment);
+    }
+
+    // Copy of s that lives as long as the arena.
+    std::string_view copy(std::string_view s);
+
+    // A new, separate arena that is freed together with this one: lets another
+    // thread allocate parts of the same compilation.
+    Arena& child();
+
+    // Arena the calling thread allocates from: the innermost live Scope, or a
+    // thread-local fallback that lasts until the thread exits.
+    static Arena& current();
+
+    // Makes an arena current for this thread until the scope ends.
+    class Scope {
+    public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena* previous;
+    };
+
+private:
+    std::pmr::monotonic_buffer_resource pool;
+    std::vector<std::unique_ptr<Arena>> children;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include "parser.hpp"
+#include "fileio.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Binary snapshot of a parsed tree, kept next to its source as "<source>c"
+// (page.eaml -> page.eamlc). It is keyed by a hash of the source bytes, the compiler
+// version and the lexer and parser sources it was built from, so any edit, upgrade
+// or rebuild with other parsing code invalidates it.
+//
+// Loading maps the file once: node strings point straight into the mapping, names
+// are re-interned once per distinct name, and nodes are built in the current Arena.
+class AstCache {
+public:
+    // Bump whenever the node layout or the parser's output for some input changes
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    explicit AstCache(const std::string& sourcePath);
+
+    // The tree cached for this exact source, or nullptr if there is none, it is
+    // stale, or it can't be read. The tree points into the mapping held here, so
+    // the AstCache must outlive it.
+    std::unique_ptr<RootNode> load(std::string_view source);
+
+    // Returns true if the cache file was (re)written. Failures are not errors:
+    // the next run just parses again.
+    bool store(std::string_view source, const RootNode& root);
+
+    const std::string& path() const { return cachePath; }
+
+private:
+    std::string cachePath;
+    std::unique_ptr<MappedFile> mapping;
+};
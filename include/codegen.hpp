@@ -1,18 +1,88 @@
 #pragma once
 #include "parser.hpp"
+#include "anaylzer.hpp"
+#include "fileio.hpp"
+#include "stylesheet.hpp"
+#include "threadpool.hpp"
+#include <string>
+#include <string_view>
 #include <unordered_map>
-#include <memory>
-#include <vector>
+#include <unordered_set>
 
 class CodeGenerator {
+public:
+    // Rendered @load instances, reused when the same component comes up again with
+    // the same parameter values. Counts are for the last render.
+    struct FragmentStats {
+        size_t hits = 0;   // instances written from the cache
+        size_t misses = 0; // instances rendered
+    };
+
+    // A fragment is kept once its key shows up a second time, up to these sizes
+    static constexpr size_t MAX_FRAGMENT_SIZE = 64 * 1024;
+    static constexpr size_t MAX_CACHE_SIZE = 16 * 1024 * 1024; // keys and fragments
+    // Deeper instances go uncached: their keys would look up the whole chain of scopes
+    static constexpr size_t MAX_CACHED_DEPTH = 32;
+
 private:
-    std::unordered_map<std::string, std::vector<std::unique_ptr<ASTNode>>> atSaveTable;
+    const Analysis* analysis = nullptr;
 
-    std::unique_ptr<ASTNode> cloneNode(const ASTNode* node);
-    void expandLoadsInList(std::vector<std::unique_ptr<ASTNode>>& list);
-    std::string generateHTMLOutput(RootNode& root);
+    struct Fragment {
+        std::string html;
+        bool stored = false;
+        bool tooLarge = false;
+    };
+    // Keyed by component body and the value of every slot the instance reads. Keys
+    // seen only once so far are just remembered by hash, in sightings.
+    std::unordered_map<std::string, Fragment> fragments;
+    std::unordered_set<uint64_t> sightings;
+    size_t cacheSize = 0;
+    FragmentStats stats;
+    std::string_view newline = "\n"; // after tags, none when minifying
+
+    void reset(const Analysis& analysis);
+    std::string_view findTitle(const NodeList& page);
+    SelectorUsage usedSelectors(const NodeList& page);
+    // <style> with the page's stylesheet, or a <link> to it written into dir
+    std::string styleTag(const NodeList& page, const std::string& dir);
+    void writeHead(std::string_view title, std::string_view style, OutputSink& out);
+    // Renders top-level statements [first, last) of the page into <body>
+    void renderNodes(const NodeList& page, size_t first, size_t last, OutputSink& out);
 
 
 public:
-    void generate(RootNode& root);
+    // Link the stylesheet as a content-hashed file written next to the page
+    // (style.<hash>.css) instead of inlining it
+    bool externalStylesheet = false;
+    // Leave out the newlines between tags and the stylesheet's insignificant
+    // whitespace and comments, as the page is written
+    bool minify = false;
+    // Level (1-11) of the .gz/.br copies written next to every file; 0 for none
+    int precompressLevel = 0;
+
+    // Writes the page of an analyzeTree() result to output.html; returns false if it
+    // was already up to date. The tree behind the analysis is left untouched so it
+    // can be analyzed and rendered again.
+    //
+    // The generators throw std::runtime_error on errors in the page (an unknown
+    // @load where one must exist) or when a file can't be written; files not yet
+    // committed are left as they were.
+    bool generate(const Analysis& analysis);
+
+    // Renders the same page into any sink, e.g. one on stdout. The caller flushes.
+    void render(const Analysis& analysis, OutputSink& out);
+
+    // Multi-file output: each top-level @screen becomes <dir>/<name>.html, rendered
+    // on the pool when there is one, and <dir>/index.html holds the rest of the page
+    // and a link to every screen. Returns how many files changed.
+    size_t generateSplit(const Analysis& analysis, const std::string& dir, ThreadPool* pool);
+
+    // C++ back end: writes a header to path with an inline function per reachable
+    // component, taking its placeholders as arguments, one per top-level screen, and
+    // page() for the whole document. What doesn't depend on the arguments is rendered
+    // into string constants, so calling them walks no tree. Returns false if the file
+    // was already up to date.
+    bool generateCpp(const Analysis& analysis, const std::string& path);
+
+    const FragmentStats& fragmentStats() const { return stats; }
 };
@@ -1,12 +1,15 @@
 #pragma once
 
-#include <sstream>
-#include <fstream>
 #include <string>
+#include <stdexcept>
+#include "fileio.hpp"
 
+// Whole file as an owned string (empty if it can't be read). Prefer MappedFile
+// when the bytes don't need to outlive the file.
 inline std::string readFile(const char* filename) {
-    std::ifstream file(filename);
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    try {
+        return std::string(MappedFile(filename).view());
+    } catch (const std::runtime_error&) {
+        return std::string();
+    }
 }
@@ -0,0 +1,35 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Compressed copies of a file, written next to it as the file itself is written:
+// <path>.gz, and <path>.br when built with Brotli. Each chunk is compressed as it
+// comes, so nothing is held back for a pass over the finished file. The copies go
+// through AtomicFileWriter, so unchanged ones keep their timestamps too.
+class CompressedCopies {
+public:
+    static constexpr int DEFAULT_LEVEL = 9;
+
+    // Extensions of the copies this build can write, e.g. ".gz .br"; empty if none
+    static std::string_view formats();
+
+    // Deletes any copies of path left by an earlier run, whatever build wrote them
+    static void remove(const std::string& path);
+
+    // level is 1-11: gzip stops at 9, Brotli goes on to 11. Throws std::runtime_error.
+    CompressedCopies(const std::string& path, int level);
+    ~CompressedCopies();
+
+    CompressedCopies(const CompressedCopies&) = delete;
+    CompressedCopies& operator=(const CompressedCopies&) = delete;
+
+    void write(std::string_view data);
+
+    // Finishes every copy; returns how many of them were (re)written
+    size_t commit();
+
+private:
+    struct Streams;
+    std::unique_ptr<Streams> streams;
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <cstring>
+#include "hash.hpp"
+
+// Read-only memory mapping of an input file. The view stays valid for the lifetime
+// of the object, so tokens and AST strings can point straight into it.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path); // throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+private:
+    void release();
+
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+// Writes a file through a large buffer into a temp file next to the target, then
+// atomically renames it over the target on commit(). If the new content hashes the
+// same as the file already on disk, the target is left untouched (no mtime change,
+// no reload downstream). Dropping the writer without commit() discards everything.
+class AtomicFileWriter {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    explicit AtomicFileWriter(std::string path, size_t bufferSize = DEFAULT_BUFFER_SIZE); // throws std::runtime_error
+    ~AtomicFileWriter();
+
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    void write(std::string_view data);
+
+    // Returns true if the target was (re)written, false if it was already up to date.
+    bool commit();
+
+    const std::string& path() const { return target; }
+
+private:
+    void flush();
+    void discard();
+
+    std::string target;
+    std::string tempPath;
+    std::vector<char> buffer;
+    size_t used = 0;
+    uint64_t written = 0;
+    ContentHash hash;
+    int fd = -1;
+};
+
+// How a string is escaped on its way into HTML
+enum class Escape {
+    None,
+    Text,      // '&', '<' and '>' become entities
+    Attribute, // so do '"' and '\'', for a quoted attribute value
+};
+
+// Where the code generator renders to. Writes collect in a fixed buffer that is
+// handed on whenever it fills up (and on flush()), so memory use is bounded by the
+// buffer, not by the page. Writes larger than the buffer skip it.
+class OutputSink {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    // Chunks go to a callback; it may throw std::runtime_error to abort rendering
+    explicit OutputSink(std::function<void(std::string_view)> consumer, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    void write(std::string_view data) {
+        if (tape) tape->append(data);
+        if (data.size() <= buffer.size() - used) {
+            std::memcpy(buffer.data() + used, data.data(), data.size());
+            used += data.size();
+        } else {
+            spill(data);
+        }
+    }
+
+    OutputSink& operator<<(std::string_view data) {
+        write(data);
+        return *this;
+    }
+
+    // data with what is special in context written as entities. Clean runs are
+    // found 16/32 bytes at a time (scan kernels) and copied whole.
+    void write(std::string_view data, Escape context);
+
+    // Hands on whatever is buffered. Not done on destruction: call it when done.
+    void flush();
+
+    // While set, everything written is also appended to tape (nullptr stops it)
+    void tee(std::string* tape) { this->tape = tape; }
+
+private:
+    void spill(std::string_view data);
+
+    std::function<void(std::string_view)> consumer;
+    std::vector<char> buffer;
+    size_t used = 0;
+    std::string* tape = nullptr;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Streaming 64-bit content hash (not cryptographic). Consumes 8 bytes per step and
+// gives the same digest however the input is split across update() calls.
+class ContentHash {
+public:
+    explicit ContentHash(uint64_t seed = 0) : state(seed ^ 0x9E3779B97F4A7C15ull) {}
+
+    void update(std::string_view data) {
+        const char* p = data.data();
+        size_t n = data.size();
+        length += n;
+        if (n == 0) return;
+
+        // Finish a word left over from the previous call
+        if (pending) {
+            size_t take = std::min(n, sizeof tail - pending);
+            std::memcpy(tail + pending, p, take);
+            pending += take;
+            p += take;
+            n -= take;
+            if (pending < sizeof tail) return;
+            mix(load(tail));
+            pending = 0;
+        }
+
+        for (; n >= 8; p += 8, n -= 8)
+            mix(load(p));
+
+        std::memcpy(tail, p, n);
+        pending = n;
+    }
+
+    uint64_t digest() const {
+        uint64_t h = state;
+        uint64_t last = 0;
+        for (size_t i = 0; i < pending; i++)
+            last |= static_cast<uint64_t>(static_cast<unsigned char>(tail[i])) << (8 * i);
+        h = round(h, last ^ (static_cast<uint64_t>(length) << 56));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static uint64_t of(std::string_view data, uint64_t seed = 0) {
+        ContentHash h(seed);
+        h.update(data);
+        return h.digest();
+    }
+
+private:
+    static uint64_t load(const char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64(v); // digest must not depend on the host
+#endif
+        return v;
+    }
+
+    static uint64_t round(uint64_t h, uint64_t word) {
+        h ^= word * 0x87C37B91114253D5ull;
+        h = (h << 31) | (h >> 33);
+        return h * 0x4CF5AD432745937Full + 0x52DCE729ull;
+    }
+
+    void mix(uint64_t word) { state = round(state, word); }
+
+    uint64_t state;
+    uint64_t length = 0;
+    char tail[8] = {};
+    size_t pending = 0;
+};
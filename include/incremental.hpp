@@ -0,0 +1,47 @@
+#pragma once
+#include "parser.hpp"
+#include "arena.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Front end for -dev watch mode. Keeps the previous source and the tree parsed from
+// it; on every update only the top-level blocks (an '@' at column 0 up to the next
+// one) that differ from last time are re-lexed and re-parsed, and their statements
+// are spliced into the existing RootNode. Unchanged @screen/@save subtrees are reused.
+// Each block is parsed from its own copy of the text into its own Arena, so a block
+// that goes away takes its nodes' memory with it.
+class IncrementalCompiler {
+public:
+    struct Stats {
+        size_t blocks = 0;
+        size_t reparsed = 0;
+    };
+
+    // Throws on lex/parse errors, in which case the previous tree is kept.
+    // Changed blocks are parsed on the pool when one is given.
+    const RootNode& update(std::string newSource, ThreadPool* pool = nullptr);
+
+    const RootNode& tree() const { return root; }
+    const Stats& stats() const { return lastStats; }
+
+private:
+    struct Block {
+        size_t offset;     // into source
+        size_t length;
+        size_t statements; // how many root statements came out of it
+        std::unique_ptr<Arena> arena;
+    };
+
+    std::string_view blockText(const Block& block) const {
+        return std::string_view(source).substr(block.offset, block.length);
+    }
+
+    std::string source;
+    std::vector<Block> blocks;
+    // Declared after blocks: the statements must go before the arenas they live in
+    RootNode root{std::pmr::new_delete_resource()};
+    Stats lastStats;
+};
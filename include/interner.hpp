@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compact ID of an interned name (identifiers, component, tag, parameter and
+// layout names). Equal names always get the same Symbol, so comparing and hashing
+// names is integer work. Symbol 0 is the empty name.
+using Symbol = uint32_t;
+
+// Process-wide string interner. intern() may be called from several threads at
+// once (the parallel lexer does); name() never blocks and stays valid for the
+// life of the process.
+class Interner {
+public:
+    Interner();
+
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    Symbol intern(std::string_view name);
+    std::string_view name(Symbol symbol) const;
+
+    static Interner& global();
+
+private:
+    // Names are spread over shards by hash to keep lock contention low; a Symbol
+    // is (index within shard << SHARD_BITS) | shard.
+    static constexpr unsigned SHARD_BITS = 4;
+    static constexpr unsigned SHARDS = 1u << SHARD_BITS;
+    static constexpr unsigned PAGE_BITS = 12;
+    static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_BITS;
+    static constexpr size_t MAX_PAGES = 4096; // 16M names per shard
+    static constexpr size_t CHAR_BLOCK = 64 * 1024;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, Symbol> lookup;
+        // Fixed page directory so readers never see it move
+        std::unique_ptr<std::unique_ptr<std::string_view[]>[]> pages{new std::unique_ptr<std::string_view[]>[MAX_PAGES]};
+        size_t count = 0;
+        std::vector<std::unique_ptr<char[]>> chars;
+        char* nextChar = nullptr;
+        size_t charsLeft = 0;
+    };
+
+    std::string_view store(Shard& shard, std::string_view name);
+
+    Shard shards[SHARDS];
+};
+
+inline Symbol intern(std::string_view name) {
+    return Interner::global().intern(name);
+}
+
+inline std::string_view symbolName(Symbol symbol) {
+    return Interner::global().name(symbol);
+}
@@ -1,10 +1,12 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <optional>
-#include <unordered_map>
+#include "scan.hpp"
+#include "interner.hpp"
 
-enum class TokenType {
+enum class TokenType : uint8_t {
 
     AT_TITLE,
     AT_CONSTANT,
@@ -37,37 +39,210 @@ enum class TokenType {
     END_OF_FILE
 };
 
+// Tokens don't own their text: value is a view into the source buffer handed to
+// the Lexer, which must outlive every token (and everything that reads them).
+// Names (IDENTIFIER, AT_IDENTIFIER) are interned as they are lexed.
+// STRING values are the raw body between the quotes; escapes are only decoded
+// by text() when a consumer actually needs the final string (into the current
+// Arena, so the result lives as long as the tree built from it).
 struct Token {
     TokenType type;
-    std::optional<std::string> value;
+    std::string_view value;
     size_t line;
+    bool escaped = false; // STRING only: value still contains \" or \\ sequences
+    Symbol symbol = 0;    // IDENTIFIER and AT_IDENTIFIER: interned value
+
+    std::string_view text() const;
 };
 
+// Lexed tokens stored column-wise: one byte of type per token, with the spans,
+// line numbers and symbols in parallel arrays. The parser's lookahead loops
+// (counting INDENTs, skipping NEWLINEs) then only scan the dense type bytes.
+class TokenBuffer {
+public:
+    void reserve(size_t count);
+    void resize(size_t count);
+    void push(const Token& token);
+    // Overwrite [at, at + count) with the first count tokens of from
+    void copyFrom(const TokenBuffer& from, size_t count, size_t at);
+
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+
+    TokenType type(size_t i) const { return types[i]; }
+    size_t line(size_t i) const { return lines[i]; }
+    // The whole token, put back together
+    Token operator[](size_t i) const;
+
+private:
+    std::vector<TokenType> types;
+    std::vector<std::string_view> values;
+    std::vector<uint32_t> lines;
+    std::vector<uint32_t> payloads; // names: Symbol, STRING: 1 if escaped
+};
+
+class ThreadPool;
+
+// Place where the source can be cut into independently lexable chunks: an '@' at
+// column 0 that is outside any string literal or comment, together with the line
+// number the lexer is at there.
+struct SourceSplit {
+    size_t offset;
+    size_t line;
+};
+
+// Top-level split points at least minChunk bytes apart, starting with {0, 1}.
+std::vector<SourceSplit> findTopLevelSplits(std::string_view source, size_t minChunk,
+                                            const scan::Kernels& kernels = scan::best());
+
 class Lexer {
 public:
-    Lexer(const std::string& source);
-    std::vector<Token> tokenize();
+    // kernels selects the byte-scanning loops (SIMD by default, see scan.hpp)
+    Lexer(std::string_view source, const scan::Kernels& kernels = scan::best());
+    // For lexing a slice of a bigger source: line numbers start at firstLine
+    Lexer(std::string_view source, size_t firstLine, const scan::Kernels& kernels = scan::best());
+
+    // Pull the next token. Returns END_OF_FILE forever once the source is exhausted.
+    Token next();
+
+    // Convenience wrapper: lex the whole source up front (ends with END_OF_FILE).
+    TokenBuffer tokenize();
+
+    // Same token stream as tokenize(), but the source is cut at top-level splits
+    // and the chunks are lexed on the pool. Worth it from a few hundred KB up.
+    TokenBuffer tokenizeParallel(ThreadPool& pool);
 
 private:
-    const std::string source;
+    std::string_view source;
+    const scan::Kernels& kernels;
     size_t pos = 0;
     size_t line = 1;
 };
 
-static const std::unordered_map<std::string, TokenType> BUILTIN_AT_TOKENS = {
-    {"title", TokenType::AT_TITLE},
-    {"const", TokenType::AT_CONSTANT},
-    {"save", TokenType::AT_SAVE},
-    {"screen", TokenType::AT_SCREEN},
-    {"load", TokenType::AT_LOAD},
-    {"row", TokenType::AT_ROW},
-    {"stack", TokenType::AT_STACK},
-    {"center", TokenType::AT_CENTER},
-    {"left", TokenType::AT_LEFT},
-    {"right", TokenType::AT_RIGHT},
-    {"text", TokenType::AT_TEXT}
+// What the Parser reads from: either pulls tokens from a Lexer on demand through a
+// small ring buffer (token memory stays O(lookahead) whatever the input size), or
+// borrows an already lexed TokenBuffer without copying it. Past the end, peeks and
+// consume() keep returning the END_OF_FILE token.
+class TokenStream {
+public:
+    explicit TokenStream(Lexer& lexer);
+    explicit TokenStream(const TokenBuffer& tokens, size_t start = 0); // must outlive the stream
+
+    TokenType type(size_t offset = 0);
+    size_t line(size_t offset = 0);
+    Token consume();
+
+    // Borrowed mode only (nullptr when streaming): the buffer and where we are in it
+    const TokenBuffer* buffer() const { return borrowed; }
+    size_t position() const { return index; }
+    void seek(size_t position) { index = position; }
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 16; // power of two
+
+    void fill(size_t count);
+
+    // Borrowed mode
+    const TokenBuffer* borrowed = nullptr;
+    size_t index = 0;
+
+    // Streaming mode: ring[head .. head + buffered) are the next tokens
+    Lexer* lexer = nullptr;
+    std::vector<Token> ring;
+    size_t head = 0;
+    size_t buffered = 0;
+    bool eof = false;
+};
+
+// Keywords, in one list: @-keywords (@title, @save, ...) and bare ones (with).
+// Lookups go through a perfect hash built at compile time from this list, so
+// there is no startup cost and no allocation per identifier.
+struct Keyword {
+    std::string_view name;
+    TokenType type;
+    bool at; // only recognized after '@'
+};
+
+inline constexpr Keyword KEYWORDS[] = {
+    {"title", TokenType::AT_TITLE, true},
+    {"const", TokenType::AT_CONSTANT, true},
+    {"save", TokenType::AT_SAVE, true},
+    {"screen", TokenType::AT_SCREEN, true},
+    {"load", TokenType::AT_LOAD, true},
+    {"row", TokenType::AT_ROW, true},
+    {"stack", TokenType::AT_STACK, true},
+    {"center", TokenType::AT_CENTER, true},
+    {"left", TokenType::AT_LEFT, true},
+    {"right", TokenType::AT_RIGHT, true},
+    {"text", TokenType::AT_TEXT, true},
+    {"with", TokenType::WITH, false}
 };
 
-static const std::unordered_map<std::string, TokenType> BUILTIN_TOKENS = {
-    {"with", TokenType::WITH}
+namespace keywords {
+
+constexpr size_t COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+constexpr size_t TABLE_SIZE = 32;
+static_assert(COUNT < TABLE_SIZE, "keyword table is too small");
+
+constexpr size_t hash(std::string_view s, unsigned multiplier) {
+    return (s.size() + static_cast<unsigned char>(s.front())
+            + static_cast<unsigned char>(s.back()) * multiplier) & (TABLE_SIZE - 1);
+}
+
+// Smallest multiplier for which no two keywords share a slot (0 if none).
+constexpr unsigned findMultiplier() {
+    for (unsigned m = 1; m < 256; m++) {
+        bool used[TABLE_SIZE] = {};
+        bool collision = false;
+        for (size_t i = 0; i < COUNT && !collision; i++) {
+            size_t h = hash(KEYWORDS[i].name, m);
+            collision = used[h];
+            used[h] = true;
+        }
+        if (!collision) return m;
+    }
+    return 0;
+}
+
+constexpr unsigned MULTIPLIER = findMultiplier();
+static_assert(MULTIPLIER != 0, "no collision-free hash for KEYWORDS, grow TABLE_SIZE");
+
+struct Table {
+    signed char slots[TABLE_SIZE];
 };
+
+constexpr Table buildTable() {
+    Table table = {};
+    for (size_t i = 0; i < TABLE_SIZE; i++) table.slots[i] = -1;
+    for (size_t i = 0; i < COUNT; i++) table.slots[hash(KEYWORDS[i].name, MULTIPLIER)] = static_cast<signed char>(i);
+    return table;
+}
+
+inline constexpr Table TABLE = buildTable();
+
+// Index of name in KEYWORDS, -1 when it isn't a keyword.
+constexpr int find(std::string_view name) {
+    if (name.empty()) return -1;
+    signed char slot = TABLE.slots[hash(name, MULTIPLIER)];
+    if (slot < 0 || KEYWORDS[slot].name != name) return -1;
+    return slot;
+}
+
+}
+
+// Keyword type of "@name", AT_IDENTIFIER for generic tags.
+constexpr TokenType lookupAtKeyword(std::string_view name) {
+    int i = keywords::find(name);
+    return i >= 0 && KEYWORDS[i].at ? KEYWORDS[i].type : TokenType::AT_IDENTIFIER;
+}
+
+// Keyword type of a bare word, IDENTIFIER when it isn't one.
+constexpr TokenType lookupKeyword(std::string_view name) {
+    int i = keywords::find(name);
+    return i >= 0 && !KEYWORDS[i].at ? KEYWORDS[i].type : TokenType::IDENTIFIER;
+}
+
+static_assert(lookupAtKeyword("screen") == TokenType::AT_SCREEN);
+static_assert(lookupAtKeyword("with") == TokenType::AT_IDENTIFIER);
+static_assert(lookupKeyword("with") == TokenType::WITH);
+static_assert(lookupKeyword("screens") == TokenType::IDENTIFIER);
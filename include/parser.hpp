@@ -1,113 +1,239 @@
 #pragma once
 #include "lexer.hpp"
+#include "interner.hpp"
+#include "arena.hpp"
 #include <memory>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
 #include <vector>
 #include <string>
 
+struct ASTNode;
+
+// Concrete type of a node, so passes dispatch with a switch instead of RTTI
+enum class NodeKind : uint8_t {
+    Root,
+    Title,
+    Screen,
+    Text,
+    Parameter,
+    Save,
+    Load,
+    GenericAt,
+    Layout,
+    Const,
+};
+
+// Child lists and strings of a node live in the Arena that was current when the node
+// was created, so a whole tree can be dropped without walking it.
+using NodeList = std::pmr::vector<std::unique_ptr<ASTNode>>;
+using HtmlAttributes = std::pmr::vector<std::pair<Symbol, std::string_view>>;
+
 struct ASTNode {
+    // Nodes are bump-allocated from the current Arena and released with it
+    static void* operator new(size_t size) { return Arena::current().allocate(size); }
+    static void operator delete(void*) noexcept {}
+
+    const NodeKind kind;
+
+    explicit ASTNode(NodeKind kind) : kind(kind) {}
     virtual ~ASTNode() = default;
     virtual void print(int indent = 0) const = 0;
 
     // Return pointer to an owned children vector if this node type contains ASTNode children.
     // Default: no children.
-    virtual std::vector<std::unique_ptr<ASTNode>>* children() { return nullptr; }
+    virtual NodeList* children() { return nullptr; }
 
     // HTML Data
-    virtual std::vector<std::pair<std::string, std::string>>* htmlData() { return nullptr; }
+    virtual HtmlAttributes* htmlData() { return nullptr; }
 };
 
 struct RootNode : ASTNode {
-    std::vector<std::unique_ptr<ASTNode>> statements;
+    static constexpr NodeKind KIND = NodeKind::Root;
+    NodeList statements;
+    RootNode(std::pmr::memory_resource* resource = Arena::current().resource()) : ASTNode(KIND), statements(resource) {}
     void print(int indent = 0) const override;
-    std::vector<std::unique_ptr<ASTNode>>* children() override { return &statements; }
+    NodeList* children() override { return &statements; }
 };
 
 struct TitleStmtNode : ASTNode {
-    std::string title;
-    TitleStmtNode(const std::string& t) : title(t) {}
+    static constexpr NodeKind KIND = NodeKind::Title;
+    std::string_view title;
+    TitleStmtNode(std::string_view t) : ASTNode(KIND), title(t) {}
     void print(int indent = 0) const override;
 };
 
 struct ScreenStmtNode : ASTNode {
-    std::string name;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    ScreenStmtNode(const std::string& n) : name(n) {}
+    static constexpr NodeKind KIND = NodeKind::Screen;
+    Symbol name;
+    NodeList body{Arena::current().resource()};
+    ScreenStmtNode(Symbol n) : ASTNode(KIND), name(n) {}
     void print(int indent = 0) const override;
-    std::vector<std::unique_ptr<ASTNode>>* children() override { return &body; }
+    NodeList* children() override { return &body; }
 };
 
 struct TextStmtNode : ASTNode {
-    std::string text;
-    TextStmtNode(const std::string& t) : text(t) {}
+    static constexpr NodeKind KIND = NodeKind::Text;
+    std::string_view text;
+    TextStmtNode(std::string_view t) : ASTNode(KIND), text(t) {}
     void print(int indent = 0) const override;
 };
 
 struct ParameterNode : ASTNode {
-    std::string name;
-    std::string value;
-    ParameterNode(const std::string& n, const std::string& v) : name(n), value(v) {}
+    static constexpr NodeKind KIND = NodeKind::Parameter;
+    Symbol name;
+    std::string_view value;
+    ParameterNode(Symbol n, std::string_view v) : ASTNode(KIND), name(n), value(v) {}
     void print(int indent = 0) const override;
     // ParameterNode is a leaf; no children() override.
 };
 
 struct SaveStmtNode : ASTNode {
-    std::string name;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    SaveStmtNode(const std::string& n) : name(n) {}
+    static constexpr NodeKind KIND = NodeKind::Save;
+    Symbol name;
+    NodeList body{Arena::current().resource()};
+    SaveStmtNode(Symbol n) : ASTNode(KIND), name(n) {}
     void print(int indent = 0) const override;
-    std::vector<std::unique_ptr<ASTNode>>* children() override { return &body; }
+    NodeList* children() override { return &body; }
 };
 
 struct LoadStmtNode : ASTNode {
-    std::string name;
-    std::vector<std::unique_ptr<ParameterNode>> parameters;
-    LoadStmtNode(const std::string& n) : name(n) {}
+    static constexpr NodeKind KIND = NodeKind::Load;
+    Symbol name;
+    std::pmr::vector<std::unique_ptr<ParameterNode>> parameters{Arena::current().resource()};
+    LoadStmtNode(Symbol n) : ASTNode(KIND), name(n) {}
     void print(int indent = 0) const override;
     // LoadStmtNode has parameters (ParameterNode) but not ASTNode-body children
     // so we don't expose children() for structural AST replacement purposes.
 };
 
 struct GenericAtStmtNode : ASTNode {
-    std::string name;
-    std::string value = "";
-    std::vector<std::unique_ptr<ASTNode>> body;
-    GenericAtStmtNode(const std::string& n, const std::string& v = "") : name(n), value(v) {}
+    static constexpr NodeKind KIND = NodeKind::GenericAt;
+    Symbol name;
+    std::string_view value;
+    NodeList body{Arena::current().resource()};
+    GenericAtStmtNode(Symbol n, std::string_view v = {}) : ASTNode(KIND), name(n), value(v) {}
     void print(int indent = 0) const override;
-    std::vector<std::pair<std::string, std::string>> htmlData;
-    std::vector<std::unique_ptr<ASTNode>>* children() override { return &body; }
+    HtmlAttributes htmlData{Arena::current().resource()};
+    NodeList* children() override { return &body; }
 };
 
 struct LayoutStmtNode : ASTNode {
-    std::string layout;
+    static constexpr NodeKind KIND = NodeKind::Layout;
+    Symbol layout = 0;
     bool bordered = false;
-    std::vector<std::unique_ptr<ASTNode>> body;
+    NodeList body{Arena::current().resource()};
+    LayoutStmtNode() : ASTNode(KIND) {}
     void print(int indent = 0) const override;
+    NodeList* children() override { return &body; }
 };
 
+// @const name = value: a file-wide {name} that the analyzer folds in at compile time
+struct ConstStmtNode : ASTNode {
+    static constexpr NodeKind KIND = NodeKind::Const;
+    Symbol name;
+    std::string_view value;
+    ConstStmtNode(Symbol n, std::string_view v) : ASTNode(KIND), name(n), value(v) {}
+    void print(int indent = 0) const override;
+};
+
+// dynamic_cast replacement: the node as T (possibly const) if it is one, else nullptr
+template <typename T, typename Node>
+T* nodeCast(Node* node) {
+    return node && node->kind == std::remove_const_t<T>::KIND ? static_cast<T*>(node) : nullptr;
+}
+
+// Calls visitor with the node downcast to its concrete type, keeping const. Build
+// the visitor from lambdas with Overloaded; a `const ASTNode&` overload catches
+// every kind that has no overload of its own.
+template <typename Node, typename Visitor>
+decltype(auto) visitNode(Node& node, Visitor&& visitor) {
+    static_assert(std::is_same_v<std::remove_const_t<Node>, ASTNode>, "visitNode takes an ASTNode");
+    auto as = [&](auto* type) -> decltype(auto) {
+        using T = std::remove_pointer_t<decltype(type)>;
+        using Target = std::conditional_t<std::is_const_v<Node>, const T, T>;
+        return visitor(static_cast<Target&>(node));
+    };
+
+    switch (node.kind) {
+        case NodeKind::Root:      return as(static_cast<RootNode*>(nullptr));
+        case NodeKind::Title:     return as(static_cast<TitleStmtNode*>(nullptr));
+        case NodeKind::Screen:    return as(static_cast<ScreenStmtNode*>(nullptr));
+        case NodeKind::Text:      return as(static_cast<TextStmtNode*>(nullptr));
+        case NodeKind::Parameter: return as(static_cast<ParameterNode*>(nullptr));
+        case NodeKind::Save:      return as(static_cast<SaveStmtNode*>(nullptr));
+        case NodeKind::Load:      return as(static_cast<LoadStmtNode*>(nullptr));
+        case NodeKind::GenericAt: return as(static_cast<GenericAtStmtNode*>(nullptr));
+        case NodeKind::Layout:    return as(static_cast<LayoutStmtNode*>(nullptr));
+        case NodeKind::Const:     break;
+    }
+    return as(static_cast<ConstStmtNode*>(nullptr));
+}
+
+// Calls f on node and every node below it, parents before children and children in
+// order. Pending nodes wait on a heap-allocated stack, so any depth is fine.
+template <typename F>
+void forEachNode(ASTNode& node, F&& f) {
+    std::vector<ASTNode*> pending{&node};
+    while (!pending.empty()) {
+        ASTNode* next = pending.back();
+        pending.pop_back();
+        f(*next);
+        if (NodeList* children = next->children()) {
+            for (auto it = children->rbegin(); it != children->rend(); ++it)
+                pending.push_back(it->get());
+        }
+    }
+}
+
+template <typename... Fs>
+struct Overloaded : Fs... {
+    using Fs::operator()...;
+};
+template <typename... Fs>
+Overloaded(Fs...) -> Overloaded<Fs...>;
+
 void printPrettyTree(const RootNode* root);
 
 class Parser {
 private:
-    std::vector<Token> tokens;
-    size_t pos = 0;
+    TokenStream tokens;
 
-    Token peek(int offset = 0) const;
+    TokenType peek(int offset = 0);
+    size_t currentLine();
     Token consume();
     void skipNewlines();
-    
+
+    void parseStatements(RootNode& program);
+    // A whole statement, the block under it included
     std::unique_ptr<ASTNode> parseStatement(int currentIndent);
-    std::vector<std::unique_ptr<ASTNode>> parseBlock(int parentIndent);
-    std::vector<std::unique_ptr<ParameterNode>> parseParameters(int parentIndent);
+    // Just the statement's own line(s); hasBlock is set if a block follows for its body
+    std::unique_ptr<ASTNode> parseStatementHeader(int currentIndent, bool& hasBlock);
+    // The block under owner (a statement at parentIndent) and every block nested in it
+    void parseBlock(int parentIndent, ASTNode& owner);
+    void endBlock(ASTNode& owner);
+    std::pmr::vector<std::unique_ptr<ParameterNode>> parseParameters(int parentIndent);
     
     std::unique_ptr<TitleStmtNode> parseTitleStmt();
-    std::unique_ptr<ScreenStmtNode> parseScreenStmt(int currentIndent);
+    std::unique_ptr<ScreenStmtNode> parseScreenStmt();
     std::unique_ptr<TextStmtNode> parseTextStmt();
-    std::unique_ptr<SaveStmtNode> parseSaveStmt(int currentIndent);
+    std::unique_ptr<SaveStmtNode> parseSaveStmt();
     std::unique_ptr<LoadStmtNode> parseLoadStmt(int currentIndent);
-    std::unique_ptr<GenericAtStmtNode> parseGenericAtStmt(int currentIndent);
-    std::unique_ptr<LayoutStmtNode> parseLayoutStmt(int currentIndent, TokenType type);
+    std::unique_ptr<GenericAtStmtNode> parseGenericAtStmt(bool& hasBlock);
+    std::unique_ptr<LayoutStmtNode> parseLayoutStmt(TokenType type);
+    std::unique_ptr<ConstStmtNode> parseConstStmt(int currentIndent);
 
 public:
-    Parser(const std::vector<Token>& tokens);
+    // Borrows tokens (no copy); the buffer must outlive the Parser.
+    Parser(const TokenBuffer& tokens, size_t start = 0);
+    // Streams tokens straight from the lexer with bounded lookahead.
+    Parser(Lexer& lexer);
     std::unique_ptr<RootNode> parseProgram();
+
+    // Same tree as parseProgram(), but the top-level blocks (statements starting in
+    // column 0) are parsed on the pool, each worker into its own child of the
+    // current Arena. Errors are the ones a sequential parse reports first.
+    // Needs a borrowed TokenBuffer; a streaming Parser parses sequentially.
+    std::unique_ptr<RootNode> parseProgram(ThreadPool& pool);
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+
+// Byte-scanning kernels for the Lexer's and the HTML writer's hot loops. Every kernel looks at [p, end)
+// and returns a pointer to the first byte that stops the scan, or end if none does.
+// The SIMD variants compare 16 (SSE2) or 32 (AVX2) bytes per step and must return
+// exactly what the scalar ones do.
+namespace scan {
+
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct Kernels {
+    Isa isa;
+    // First '"' or '\\' (end of a string literal body or start of an escape)
+    const char* (*stringStop)(const char* p, const char* end);
+    // First '\n' (end of a # comment)
+    const char* (*lineEnd)(const char* p, const char* end);
+    // First byte outside [A-Za-z0-9_] (end of an identifier run)
+    const char* (*identEnd)(const char* p, const char* end);
+    // First '"', '#' or '\n' (what changes string/comment state outside literals)
+    const char* (*structural)(const char* p, const char* end);
+    // First '<', '>' or '&' (what has to be escaped in HTML text)
+    const char* (*htmlText)(const char* p, const char* end);
+    // First '<', '>', '&', '"' or '\'' (what has to be escaped in an attribute value)
+    const char* (*htmlAttribute)(const char* p, const char* end);
+};
+
+// Best instruction set the running CPU supports (checked once via CPUID).
+Isa detectIsa();
+
+// Kernels for a given instruction set. Falls back to the closest supported
+// variant when the requested one isn't compiled in or not supported by the CPU.
+const Kernels& kernels(Isa isa);
+
+// Kernels for detectIsa(), what the Lexer uses by default.
+const Kernels& best();
+
+// Lower-case name of an instruction set ("scalar", "sse2", "avx2"), for reports.
+const char* isaName(Isa isa);
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+// Class and id names that end up on a page's elements
+struct SelectorUsage {
+    std::unordered_set<std::string_view> classes;
+    std::unordered_set<std::string_view> ids;
+
+    // Each name of a class="..." value
+    void addClasses(std::string_view list);
+};
+
+// css without the rules that can't match anything on the page. A selector is kept
+// unless it needs a class or id the page doesn't use; names inside parentheses
+// (:not(.x)) or attribute selectors never rule one out. Rules left without
+// selectors, conditional at-rules left empty, and comments are dropped. Everything
+// else is copied as written.
+std::string pruneStylesheet(std::string_view css, const SelectorUsage& used);
+
+// css with comments and the whitespace around punctuation taken out, runs of it
+// cut to one space, and the ';' before each '}' dropped. Strings are left as written.
+std::string minifyStylesheet(std::string_view css);
+
+// "style.<content hash>.css": a new name whenever the content changes, so the file
+// can be cached for good
+std::string hashedStylesheetName(std::string_view css);
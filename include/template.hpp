@@ -0,0 +1,96 @@
+#pragma once
+#include "interner.hpp"
+#include "arena.hpp"
+#include "fileio.hpp"
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Numbers the placeholder names of a group of templates (say, every string of one
+// component, or of a whole page), so a set of bindings is indexed by slot.
+class SlotTable {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // Slot of a name, assigned on first use
+    uint32_t slot(Symbol name);
+    // Slot of a name, or NONE if no template uses it
+    uint32_t find(Symbol name) const;
+    // Name of a slot
+    Symbol name(uint32_t slot) const { return names[slot]; }
+
+    size_t size() const { return names.size(); }
+
+private:
+    std::vector<Symbol> names;
+    std::unordered_map<Symbol, uint32_t> index;
+};
+
+// Value bound to each slot of a SlotTable; nullptr leaves the placeholder as written
+using SlotValues = std::vector<const std::string_view*>;
+
+class TextTemplate;
+struct Scope;
+
+// A string split once into literal runs and {name} placeholders. Filling it in is a
+// single pass over the segments, instead of a search and replace per name.
+class TextTemplate {
+public:
+    // A literal run, or a placeholder (text is then "{name}", kept for when it is unbound)
+    struct Segment {
+        std::string_view text;
+        uint32_t slot;
+    };
+
+    // Segments live in the current Arena; text must outlive the template
+    TextTemplate(std::string_view text, SlotTable& slots);
+
+    std::string_view source() const { return text; }
+    bool hasSlots() const { return slotted; }
+
+    // The text with every bound placeholder replaced, written straight into arena.
+    // Without a bound placeholder the source itself is returned and nothing is copied.
+    std::string_view render(const SlotValues& values, Arena& arena) const;
+
+    // The text written straight into out (escaped for context), each placeholder
+    // taking the value of the innermost scope that binds it. A value is itself
+    // rendered in the scope around the one that bound it, so it can pass on a
+    // placeholder of an outer instance.
+    void render(OutputSink& out, const Scope* scope, Escape context = Escape::None) const;
+
+    // Appends the slot of every placeholder in the text
+    void slotsInto(std::vector<uint32_t>& out) const;
+
+    // The text in order, literal runs (slot NONE) and placeholders
+    const std::pmr::vector<Segment>& parts() const { return segments; }
+
+private:
+    std::string_view text;
+    std::pmr::vector<Segment> segments;
+    bool slotted = false;
+};
+
+// A parameter of a @load, its value compiled against the same slots as the strings
+struct Binding {
+    uint32_t slot;
+    TextTemplate value;
+};
+
+// The parameters in effect inside one component instance: those of its @load, then
+// those of the instances it sits in. Scopes live on the renderer's stack.
+struct Scope {
+    const std::vector<Binding>* bindings;
+    const Scope* parent;
+
+    const TextTemplate* find(uint32_t slot) const {
+        for (const auto& binding : *bindings)
+            if (binding.slot == slot) return &binding.value;
+        return nullptr;
+    }
+};
+
+// Writes what a placeholder for slot renders as in scope; false (and nothing
+// written) if no scope binds it
+bool renderSlot(uint32_t slot, OutputSink& out, const Scope* scope);
@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops over independent chunks of
+// work (lexing chunks, top-level blocks, screens).
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Worker count, counting the calling thread which also takes part in loops.
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Runs fn(i) for every i in [0, count) and waits for all of them. If any call
+    // throws, the exception of the lowest failing index is rethrown (so errors come
+    // out in source order). Nested calls from inside fn run inline.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    // Process-wide pool, created on first use.
+    static ThreadPool& shared();
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* fn = nullptr;
+        size_t count = 0;
+        size_t next = 0;
+        size_t active = 0;
+        size_t failedIndex = 0;
+        std::exception_ptr error;
+    };
+
+    void workerLoop();
+    void runItems(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex submitMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Job job;
+    size_t generation = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,363 @@
+#include "anaylzer.hpp"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+// -------------------------------
+// Deep Clone Support
+// -------------------------------
+// A node with the same fields but an empty body
+static std::unique_ptr<ASTNode> copyNode(const ASTNode& node) {
+    return visitNode(node, Overloaded{
+        [](const TitleStmtNode& t) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<TitleStmtNode>(t.title);
+        },
+        [](const TextStmtNode& t) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<TextStmtNode>(t.text);
+        },
+        [](const ParameterNode& p) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<ParameterNode>(p.name, p.value);
+        },
+        [](const LoadStmtNode& l) -> std::unique_ptr<ASTNode> {
+            auto out = std::make_unique<LoadStmtNode>(l.name);
+            out->parameters.reserve(l.parameters.size());
+            for (auto& param : l.parameters)
+                out->parameters.push_back(std::make_unique<ParameterNode>(param->name, param->value));
+            return out;
+        },
+        [](const SaveStmtNode& s) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<SaveStmtNode>(s.name);
+        },
+        [](const ScreenStmtNode& s) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<ScreenStmtNode>(s.name);
+        },
+        [](const GenericAtStmtNode& g) -> std::unique_ptr<ASTNode> {
+            auto out = std::make_unique<GenericAtStmtNode>(g.name, g.value);
+            out->htmlData.assign(g.htmlData.begin(), g.htmlData.end());
+            return out;
+        },
+        [](const LayoutStmtNode& l) -> std::unique_ptr<ASTNode> {
+            auto out = std::make_unique<LayoutStmtNode>();
+            out->bordered = l.bordered;
+            out->layout = l.layout;
+            return out;
+        },
+        [](const ConstStmtNode& c) -> std::unique_ptr<ASTNode> {
+            return std::make_unique<ConstStmtNode>(c.name, c.value);
+        },
+        [](const RootNode&) -> std::unique_ptr<ASTNode> {
+            throw std::runtime_error("Unknown AST node type in copyNode()");
+        },
+    });
+}
+
+// Body of a node, for nodes that have one
+static const NodeList* bodyOf(const ASTNode& node) {
+    return visitNode(node, Overloaded{
+        [](const RootNode& n) -> const NodeList* { return &n.statements; },
+        [](const ScreenStmtNode& n) -> const NodeList* { return &n.body; },
+        [](const SaveStmtNode& n) -> const NodeList* { return &n.body; },
+        [](const GenericAtStmtNode& n) -> const NodeList* { return &n.body; },
+        [](const LayoutStmtNode& n) -> const NodeList* { return &n.body; },
+        [](const ASTNode&) -> const NodeList* { return nullptr; },
+    });
+}
+
+// Bodies are copied off a work list rather than recursively, so any depth is fine
+static std::unique_ptr<ASTNode> deepCopy(const ASTNode& node) {
+    std::unique_ptr<ASTNode> out = copyNode(node);
+
+    std::vector<std::pair<const NodeList*, NodeList*>> pending;
+    if (const NodeList* from = bodyOf(node)) pending.emplace_back(from, out->children());
+
+    while (!pending.empty()) {
+        auto [from, to] = pending.back();
+        pending.pop_back();
+
+        to->reserve(from->size());
+        for (const auto& child : *from) {
+            to->push_back(copyNode(*child));
+            if (const NodeList* grandchildren = bodyOf(*child))
+                pending.emplace_back(grandchildren, to->back()->children());
+        }
+    }
+    return out;
+}
+
+// -------------------------------
+// Constant Folding
+// -------------------------------
+namespace {
+
+// Values of the @consts declared so far
+class Constants {
+public:
+    bool empty() const { return values.empty(); }
+
+    bool declared(Symbol name) const {
+        uint32_t slot = slots.find(name);
+        return slot < bound.size() && bound[slot];
+    }
+
+    void declare(Symbol name, std::string_view value) {
+        uint32_t slot = slots.slot(name);
+        bound.resize(slots.size(), nullptr);
+        bound[slot] = &values.emplace_back(value);
+    }
+
+    // text with the constants filled in (copied into the arena only if one was)
+    std::string_view fill(std::string_view text) {
+        if (text.find('{') == std::string_view::npos) return text;
+        TextTemplate compiled(text, slots);
+        bound.resize(slots.size(), nullptr);
+        return compiled.render(bound, Arena::current());
+    }
+
+private:
+    SlotTable slots;
+    SlotValues bound;
+    std::deque<std::string_view> values; // stable addresses for bound
+};
+
+// Fills constants into every string a page can show: titles, text, tag headers and
+// attributes, and the arguments of a @load (before they reach a component)
+void foldConstants(ASTNode* node, Constants& constants) {
+    forEachNode(*node, [&](ASTNode& each) {
+        visitNode(each, Overloaded{
+            [&](TitleStmtNode& title) { title.title = constants.fill(title.title); },
+            [&](TextStmtNode& text) { text.text = constants.fill(text.text); },
+            [&](GenericAtStmtNode& generic) {
+                generic.value = constants.fill(generic.value);
+                for (auto& attribute : generic.htmlData)
+                    attribute.second = constants.fill(attribute.second);
+            },
+            [&](LoadStmtNode& load) {
+                for (auto& param : load.parameters)
+                    param->value = constants.fill(param->value);
+            },
+            [](ASTNode&) {},
+        });
+    });
+}
+
+} // namespace
+
+// -------------------------------
+// Analysis
+// -------------------------------
+const NodeList* Analysis::component(Symbol name) const {
+    auto it = bodies.find(name);
+    return it == bodies.end() ? nullptr : it->second;
+}
+
+const Analysis::Instance* Analysis::instance(const LoadStmtNode& load) const {
+    auto it = instances.find(&load);
+    return it == instances.end() ? nullptr : &it->second;
+}
+
+const TextTemplate* Analysis::text(const ASTNode& node) const {
+    auto it = strings.find(&node);
+    return it == strings.end() ? nullptr : &it->second;
+}
+
+namespace {
+
+// Only screens and layouts render their bodies, so only loads in those are uses.
+// Loads under a nested @save or inside a tag's body never make it to the page.
+bool rendersBody(const ASTNode& node) {
+    return node.kind == NodeKind::Screen || node.kind == NodeKind::Layout;
+}
+
+void collectLoads(const NodeList& list, std::vector<const LoadStmtNode*>& out) {
+    // (list, next index) pairs: a work list in place of recursion
+    std::vector<std::pair<const NodeList*, size_t>> pending{{&list, 0}};
+    while (!pending.empty()) {
+        auto& [nodes, next] = pending.back();
+        if (next == nodes->size()) {
+            pending.pop_back();
+            continue;
+        }
+
+        const ASTNode& node = *(*nodes)[next++];
+        if (auto* load = nodeCast<const LoadStmtNode>(&node))
+            out.push_back(load);
+        else if (rendersBody(node))
+            pending.emplace_back(bodyOf(node), 0);
+    }
+}
+
+// Compiles the strings of a component body that parameters can fill: the text of
+// @text and the header of a tag, wherever the body renders them. Their slots go to reads.
+void compileStrings(const NodeList& body, SlotTable& slots,
+                    std::unordered_map<const ASTNode*, TextTemplate>& out,
+                    std::vector<uint32_t>& reads) {
+    std::vector<std::pair<const NodeList*, size_t>> pending{{&body, 0}};
+    while (!pending.empty()) {
+        auto& [nodes, next] = pending.back();
+        if (next == nodes->size()) {
+            pending.pop_back();
+            continue;
+        }
+
+        const ASTNode& node = *(*nodes)[next++];
+        if (auto* text = nodeCast<const TextStmtNode>(&node))
+            out.try_emplace(&node, text->text, slots).first->second.slotsInto(reads);
+        else if (auto* generic = nodeCast<const GenericAtStmtNode>(&node))
+            out.try_emplace(&node, generic->value, slots).first->second.slotsInto(reads);
+        else if (rendersBody(node))
+            pending.emplace_back(bodyOf(node), 0);
+    }
+}
+
+Analysis::Instance compileLoad(const LoadStmtNode& load, const NodeList* body, SlotTable& slots) {
+    Analysis::Instance instance;
+    instance.body = body;
+    instance.bindings.reserve(load.parameters.size());
+    for (const auto& param : load.parameters) {
+        uint32_t slot = slots.slot(param->name);
+        auto same = std::find_if(instance.bindings.begin(), instance.bindings.end(),
+                                 [&](const Binding& b) { return b.slot == slot; });
+        if (same != instance.bindings.end())
+            same->value = TextTemplate(param->value, slots);
+        else
+            instance.bindings.push_back({slot, TextTemplate(param->value, slots)});
+    }
+    return instance;
+}
+
+} // namespace
+
+Analysis analyzeTree(const RootNode& root) {
+    Analysis analysis;
+
+    // 0. Constants, each value with the constants declared before it filled in. Without
+    //    any the page is the tree itself, otherwise a folded copy that drops the @consts.
+    Constants constants;
+    for (const auto& stmt : root.statements) {
+        if (auto* constant = nodeCast<const ConstStmtNode>(stmt.get())) {
+            if (constants.declared(constant->name))
+                throw std::runtime_error("@const " + std::string(symbolName(constant->name)) + " is declared twice");
+            constants.declare(constant->name, constants.fill(constant->value));
+        }
+    }
+
+    if (constants.empty()) {
+        analysis.source = &root.statements;
+    } else {
+        for (const auto& stmt : root.statements) {
+            if (stmt->kind == NodeKind::Const) continue;
+            std::unique_ptr<ASTNode> copy = deepCopy(*stmt);
+            foldConstants(copy.get(), constants);
+            analysis.folded.push_back(std::move(copy));
+        }
+    }
+    const NodeList& statements = analysis.statements();
+
+    // 1. Components; a later @save of a name replaces the earlier one
+    std::unordered_map<Symbol, const SaveStmtNode*> components;
+    for (const auto& stmt : statements) {
+        if (auto* save = nodeCast<const SaveStmtNode>(stmt.get()))
+            components[save->name] = save;
+    }
+
+    // 2. Uses outside of any component are where reachability starts
+    std::vector<const LoadStmtNode*> uses;
+    collectLoads(statements, uses);
+
+    // 3. Depth-first walk with an explicit path; a component still on the path when it
+    //    is reached again closes a cycle
+    enum class State : uint8_t { Visiting, Done };
+    std::unordered_map<Symbol, State> state;
+
+    struct Visit {
+        Symbol name;
+        std::vector<const LoadStmtNode*> loads;
+        size_t next = 0;
+    };
+    std::vector<Visit> path;
+
+    auto enter = [&](Symbol name) {
+        auto component = components.find(name);
+        if (component == components.end()) {
+            // Inside a component that is an error, as it always was; on the page it is
+            // reported by the code generator where it must exist
+            if (!path.empty())
+                throw std::runtime_error("Undefined component: @load " + std::string(symbolName(name)) +
+                                         " (in @save " + std::string(symbolName(path.back().name)) + ")");
+            return;
+        }
+
+        auto [it, added] = state.emplace(name, State::Visiting);
+        if (!added) {
+            if (it->second == State::Done) return;
+
+            std::string loop;
+            auto first = std::find_if(path.begin(), path.end(), [&](const Visit& v) { return v.name == name; });
+            for (auto p = first; p != path.end(); ++p)
+                loop += std::string(symbolName(p->name)) + " -> ";
+            throw std::runtime_error("Cyclic @load: " + loop + std::string(symbolName(name)));
+        }
+
+        Visit visit{name, {}};
+        collectLoads(component->second->body, visit.loads);
+        path.push_back(std::move(visit));
+    };
+
+    for (auto* load : uses) {
+        enter(load->name);
+        while (!path.empty()) {
+            Visit& top = path.back();
+            if (top.next < top.loads.size()) {
+                enter(top.loads[top.next++]->name);
+                continue;
+            }
+            state[top.name] = State::Done;
+            analysis.expansionOrder.push_back(top.name);
+            path.pop_back();
+        }
+    }
+
+    // 4. Compile each reachable component once; every @load of it shares the result.
+    //    Dependencies come first, so what a nested @load reads is known by then.
+    auto addLoad = [&](const LoadStmtNode& load) -> const Analysis::Instance& {
+        auto component = components.find(load.name);
+        const NodeList* body = component == components.end() ? nullptr : &component->second->body;
+        return analysis.instances.emplace(&load, compileLoad(load, body, analysis.slots)).first->second;
+    };
+
+    for (Symbol name : analysis.expansionOrder) {
+        const NodeList& body = components[name]->body;
+        analysis.bodies.emplace(name, &body);
+
+        std::vector<uint32_t> reads;
+        compileStrings(body, analysis.slots, analysis.strings, reads);
+
+        std::vector<const LoadStmtNode*> loads;
+        collectLoads(body, loads);
+        for (auto* load : loads) {
+            // The values of a nested @load are filled in here; what it reads and
+            // doesn't bind itself comes from this scope. Slots it binds are its own
+            // business, whatever they are out here.
+            const Analysis::Instance& instance = addLoad(*load);
+            for (const auto& binding : instance.bindings)
+                binding.value.slotsInto(reads);
+            if (instance.body) {
+                Scope bound{&instance.bindings, nullptr};
+                for (uint32_t slot : analysis.reads.at(load->name))
+                    if (!bound.find(slot)) reads.push_back(slot);
+            }
+        }
+
+        std::sort(reads.begin(), reads.end());
+        reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+        analysis.reads.emplace(name, std::move(reads));
+    }
+    for (auto* load : uses) addLoad(*load);
+
+    for (auto& [load, instance] : analysis.instances)
+        if (instance.body) instance.reads = &analysis.reads.at(load->name);
+
+    analysis.dropped = components.size() - analysis.expansionOrder.size();
+    return analysis;
+}
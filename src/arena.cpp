@@ -0,0 +1,34 @@
+#include "arena.hpp"
+#include <cstring>
+
+static thread_local Arena* currentArena = nullptr;
+
+Arena::Arena(size_t initialSize) : pool(initialSize, std::pmr::new_delete_resource()) {}
+
+std::string_view Arena::copy(std::string_view s) {
+    if (s.empty()) return std::string_view();
+
+    char* dest = static_cast<char*>(pool.allocate(s.size(), 1));
+    std::memcpy(dest, s.data(), s.size());
+    return std::string_view(dest, s.size());
+}
+
+Arena& Arena::child() {
+    children.push_back(std::make_unique<Arena>());
+    return *children.back();
+}
+
+Arena& Arena::current() {
+    if (currentArena) return *currentArena;
+
+    static thread_local Arena fallback;
+    return fallback;
+}
+
+Arena::Scope::Scope(Arena& arena) : previous(currentArena) {
+    currentArena = &arena;
+}
+
+Arena::Scope::~Scope() {
+    currentArena = previous;
+}
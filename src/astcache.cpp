@@ -0,0 +1,369 @@
+#include "astcache.hpp"
+#include "hash.hpp"
+#include "parser_hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#ifndef EAML_VERSION
+#define EAML_VERSION "dev"
+#endif
+
+// File layout: Header, then the names used by the tree (u32 length + bytes each),
+// then the tree as a preorder stream of u32 words, then all string bytes. Strings
+// are (offset, length) word pairs into the last section, names are indexes into
+// the first. Everything is in native byte order; a cache from a machine with the
+// other one fails the format check and is simply rebuilt.
+namespace {
+
+constexpr char MAGIC[4] = {'E', 'A', 'M', 'C'};
+
+struct Header {
+    char magic[4];
+    uint32_t format;
+    uint64_t compiler;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t symbolBytes;
+    uint64_t nodeWords;
+    uint64_t stringBytes;
+    uint64_t payloadHash; // everything after the header
+};
+static_assert(sizeof(Header) == 64, "Header must not have padding");
+
+// The version, plus a digest of the lexer and parser sources taken at build time,
+// so a cache from a build with other parsing code never matches
+uint64_t compilerKey() {
+    return ContentHash::of(PARSER_SOURCE_HASH, ContentHash::of(EAML_VERSION, AstCache::FORMAT_VERSION));
+}
+
+[[noreturn]] void corrupt() {
+    throw std::runtime_error("Corrupt AST cache");
+}
+
+// Both directions walk the tree off an explicit stack rather than recursing, so
+// nesting depth is bounded by memory. A node's child list is always its last field.
+class Writer {
+public:
+    std::string symbols;
+    std::vector<uint32_t> words;
+    std::string strings;
+
+    void tree(const ASTNode& root) {
+        node(root);
+        while (!pending.empty()) {
+            auto& [list, next] = pending.back();
+            if (next == list->size()) {
+                pending.pop_back();
+                continue;
+            }
+            const ASTNode& child = *(*list)[next++];
+            node(child); // may push, moving the pair
+        }
+    }
+
+private:
+    std::unordered_map<Symbol, uint32_t> symbolIndex;
+    std::vector<std::pair<const NodeList*, size_t>> pending;
+
+    // Writes the node's own fields; its children follow once tree() gets to them
+    void node(const ASTNode& node) {
+        word(static_cast<uint32_t>(node.kind));
+
+        visitNode(node, Overloaded{
+            [&](const RootNode& root) { list(root.statements); },
+            [&](const TitleStmtNode& title) { string(title.title); },
+            [&](const ScreenStmtNode& screen) {
+                symbol(screen.name);
+                list(screen.body);
+            },
+            [&](const TextStmtNode& text) { string(text.text); },
+            [&](const ParameterNode& param) {
+                symbol(param.name);
+                string(param.value);
+            },
+            [&](const SaveStmtNode& save) {
+                symbol(save.name);
+                list(save.body);
+            },
+            [&](const LoadStmtNode& load) {
+                symbol(load.name);
+                word(static_cast<uint32_t>(load.parameters.size()));
+                for (const auto& param : load.parameters) {
+                    symbol(param->name);
+                    string(param->value);
+                }
+            },
+            [&](const GenericAtStmtNode& generic) {
+                symbol(generic.name);
+                string(generic.value);
+                word(static_cast<uint32_t>(generic.htmlData.size()));
+                for (const auto& [name, value] : generic.htmlData) {
+                    symbol(name);
+                    string(value);
+                }
+                list(generic.body);
+            },
+            [&](const LayoutStmtNode& layout) {
+                symbol(layout.layout);
+                word(layout.bordered ? 1 : 0);
+                list(layout.body);
+            },
+            [&](const ConstStmtNode& constant) {
+                symbol(constant.name);
+                string(constant.value);
+            },
+        });
+    }
+
+    void word(uint32_t value) { words.push_back(value); }
+
+    void symbol(Symbol symbol) {
+        auto [it, added] = symbolIndex.emplace(symbol, static_cast<uint32_t>(symbolIndex.size()));
+        if (added) {
+            std::string_view name = symbolName(symbol);
+            uint32_t length = static_cast<uint32_t>(name.size());
+            symbols.append(reinterpret_cast<const char*>(&length), sizeof length);
+            symbols.append(name);
+        }
+        word(it->second);
+    }
+
+    void string(std::string_view s) {
+        if (strings.size() + s.size() > UINT32_MAX)
+            throw std::runtime_error("Tree too large for the AST cache");
+        word(static_cast<uint32_t>(strings.size()));
+        word(static_cast<uint32_t>(s.size()));
+        strings.append(s);
+    }
+
+    void list(const NodeList& nodes) {
+        word(static_cast<uint32_t>(nodes.size()));
+        pending.emplace_back(&nodes, 0);
+    }
+};
+
+class Reader {
+public:
+    Reader(std::string_view words, std::string_view strings, std::vector<Symbol> symbols)
+        : words(words), strings(strings), symbols(std::move(symbols)) {}
+
+    std::unique_ptr<RootNode> root() {
+        if (kind() != NodeKind::Root) corrupt();
+        auto root = std::make_unique<RootNode>();
+        list(root->statements);
+
+        while (!pending.empty()) {
+            auto& [list, left] = pending.back();
+            if (left == 0) {
+                pending.pop_back();
+                continue;
+            }
+            left--;
+            NodeList* into = list; // node() may push, moving the pair
+            std::unique_ptr<ASTNode> read = node();
+            into->push_back(std::move(read));
+        }
+
+        if (pos != words.size()) corrupt();
+        return root;
+    }
+
+private:
+    std::string_view words;
+    std::string_view strings;
+    std::vector<Symbol> symbols;
+    size_t pos = 0;
+    // Lists still being filled, with how many nodes each is still owed
+    std::vector<std::pair<NodeList*, uint32_t>> pending;
+
+    uint32_t word() {
+        if (words.size() - pos < sizeof(uint32_t)) corrupt();
+        uint32_t value;
+        std::memcpy(&value, words.data() + pos, sizeof value);
+        pos += sizeof value;
+        return value;
+    }
+
+    // Element counts are bounded by what is left, so a bad count can't make us reserve gigabytes
+    uint32_t count() {
+        uint32_t n = word();
+        if (n > (words.size() - pos) / sizeof(uint32_t)) corrupt();
+        return n;
+    }
+
+    NodeKind kind() {
+        uint32_t value = word();
+        if (value > static_cast<uint32_t>(NodeKind::Const)) corrupt();
+        return static_cast<NodeKind>(value);
+    }
+
+    Symbol symbol() {
+        uint32_t index = word();
+        if (index >= symbols.size()) corrupt();
+        return symbols[index];
+    }
+
+    std::string_view string() {
+        uint32_t offset = word();
+        uint32_t length = word();
+        if (offset > strings.size() || length > strings.size() - offset) corrupt();
+        return strings.substr(offset, length);
+    }
+
+    // Reads the count; the nodes themselves are read by root() as it gets to them
+    void list(NodeList& out) {
+        uint32_t n = count();
+        out.reserve(n);
+        pending.emplace_back(&out, n);
+    }
+
+    std::unique_ptr<ASTNode> node() {
+        switch (kind()) {
+            case NodeKind::Title:
+                return std::make_unique<TitleStmtNode>(string());
+            case NodeKind::Screen: {
+                auto screen = std::make_unique<ScreenStmtNode>(symbol());
+                list(screen->body);
+                return screen;
+            }
+            case NodeKind::Text:
+                return std::make_unique<TextStmtNode>(string());
+            case NodeKind::Parameter: {
+                Symbol name = symbol();
+                return std::make_unique<ParameterNode>(name, string());
+            }
+            case NodeKind::Save: {
+                auto save = std::make_unique<SaveStmtNode>(symbol());
+                list(save->body);
+                return save;
+            }
+            case NodeKind::Load: {
+                auto load = std::make_unique<LoadStmtNode>(symbol());
+                uint32_t n = count();
+                load->parameters.reserve(n);
+                for (uint32_t i = 0; i < n; i++) {
+                    Symbol name = symbol();
+                    load->parameters.push_back(std::make_unique<ParameterNode>(name, string()));
+                }
+                return load;
+            }
+            case NodeKind::GenericAt: {
+                Symbol name = symbol();
+                auto generic = std::make_unique<GenericAtStmtNode>(name, string());
+                uint32_t n = count();
+                generic->htmlData.reserve(n);
+                for (uint32_t i = 0; i < n; i++) {
+                    Symbol attribute = symbol();
+                    generic->htmlData.emplace_back(attribute, string());
+                }
+                list(generic->body);
+                return generic;
+            }
+            case NodeKind::Layout: {
+                auto layout = std::make_unique<LayoutStmtNode>();
+                layout->layout = symbol();
+                layout->bordered = word() != 0;
+                list(layout->body);
+                return layout;
+            }
+            case NodeKind::Const: {
+                Symbol name = symbol();
+                return std::make_unique<ConstStmtNode>(name, string());
+            }
+            case NodeKind::Root:
+                break;
+        }
+        corrupt();
+    }
+};
+
+} // namespace
+
+AstCache::AstCache(const std::string& sourcePath) : cachePath(sourcePath + "c") {}
+
+std::unique_ptr<RootNode> AstCache::load(std::string_view source) {
+    try {
+        auto file = std::make_unique<MappedFile>(cachePath);
+        std::string_view data = file->view();
+
+        Header header;
+        if (data.size() < sizeof header) return nullptr;
+        std::memcpy(&header, data.data(), sizeof header);
+
+        if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 ||
+            header.format != FORMAT_VERSION ||
+            header.compiler != compilerKey() ||
+            header.sourceSize != source.size() ||
+            header.sourceHash != ContentHash::of(source)) {
+            return nullptr;
+        }
+
+        std::string_view rest = data.substr(sizeof header);
+        if (header.symbolBytes > rest.size() ||
+            header.nodeWords > (rest.size() - header.symbolBytes) / sizeof(uint32_t) ||
+            header.stringBytes != rest.size() - header.symbolBytes - header.nodeWords * sizeof(uint32_t) ||
+            header.payloadHash != ContentHash::of(rest)) {
+            return nullptr;
+        }
+
+        std::string_view names = rest.substr(0, header.symbolBytes);
+        std::string_view words = rest.substr(header.symbolBytes, header.nodeWords * sizeof(uint32_t));
+        std::string_view strings = rest.substr(header.symbolBytes + words.size());
+
+        // Symbols are per process: intern every name once and remap
+        std::vector<Symbol> symbols;
+        while (!names.empty()) {
+            uint32_t length;
+            if (names.size() < sizeof length) corrupt();
+            std::memcpy(&length, names.data(), sizeof length);
+            names.remove_prefix(sizeof length);
+            if (length > names.size()) corrupt();
+            symbols.push_back(intern(names.substr(0, length)));
+            names.remove_prefix(length);
+        }
+
+        std::unique_ptr<RootNode> root = Reader(words, strings, std::move(symbols)).root();
+        mapping = std::move(file);
+        return root;
+    } catch (const std::runtime_error&) {
+        // Missing or unreadable: parse as usual
+        return nullptr;
+    }
+}
+
+bool AstCache::store(std::string_view source, const RootNode& root) {
+    try {
+        Writer writer;
+        writer.tree(root);
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+        header.format = FORMAT_VERSION;
+        header.compiler = compilerKey();
+        header.sourceHash = ContentHash::of(source);
+        header.sourceSize = source.size();
+        header.symbolBytes = writer.symbols.size();
+        header.nodeWords = writer.words.size();
+        header.stringBytes = writer.strings.size();
+
+        const std::string_view words(reinterpret_cast<const char*>(writer.words.data()),
+                                     writer.words.size() * sizeof(uint32_t));
+        ContentHash payload;
+        payload.update(writer.symbols);
+        payload.update(words);
+        payload.update(writer.strings);
+        header.payloadHash = payload.digest();
+
+        AtomicFileWriter out(cachePath);
+        out.write(std::string_view(reinterpret_cast<const char*>(&header), sizeof header));
+        out.write(writer.symbols);
+        out.write(words);
+        out.write(writer.strings);
+        return out.commit();
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
@@ -1,334 +1,486 @@
 #include "codegen.hpp"
 #include <stdexcept>
-#include <iostream>
-#include <sstream>
-#include <functional>
-#include <fstream>
-#include "codeutils.hpp"
-
-void replaceNodeValueWithAppropriateContext(ASTNode* node, const std::unordered_map<std::string, std::string>& context) {
-    if (!node) return;
-
-    if (auto* param = dynamic_cast<TextStmtNode*>(node)) {
-        std::string txt = param->text;
-        // Replace placeholders like {name} with context values
-        for (auto& [k, v] : context) {
-            size_t pos = 0;
-            std::string ph = "{" + k + "}";
-            while ((pos = txt.find(ph, pos)) != std::string::npos) {
-                txt.replace(pos, ph.length(), v);
-                pos += v.length();
-            }
-        }
-        param->text = txt;
-    } else if (auto* generic = dynamic_cast<GenericAtStmtNode*>(node)) {
-        // Replace generic->value {param} with its value
-        std::string txt = generic->value;
-        for (auto& [k, v] : context) {
-            size_t pos = 0;
-            std::string ph = "{" + k + "}";
-            while ((pos = txt.find(ph, pos)) != std::string::npos) {
-                txt.replace(pos, ph.length(), v);
-                pos += v.length();
-            }
-        }
-        generic->value = txt;
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include "fileio.hpp"
+#include "hash.hpp"
+#include "compress.hpp"
+#include "stylesheet.hpp"
+#include "default_stylesheet.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A file the generator writes, plus its compressed copies with -precompress. Chunks
+// go to the copies as they come, so compression keeps pace with rendering.
+class PageWriter {
+public:
+    PageWriter(const std::string& path, int precompressLevel) : file(path, 0) {
+        if (precompressLevel > 0) copies = std::make_unique<CompressedCopies>(path, precompressLevel);
     }
 
-
-    if (node->children()) {
-        for (auto& child : *node->children()) {
-            replaceNodeValueWithAppropriateContext(child.get(), context);
-        }
+    void write(std::string_view chunk) {
+        file.write(chunk);
+        if (copies) copies->write(chunk);
     }
-}
 
-
-// -------------------------------
-// Deep Clone Support
-// -------------------------------
-std::unique_ptr<ASTNode> CodeGenerator::cloneNode(const ASTNode* node) {
-    if (!node) return nullptr;
-
-    // Title
-    if (auto* t = dynamic_cast<const TitleStmtNode*>(node)) {
-        return std::make_unique<TitleStmtNode>(t->title);
+    // Whether the file itself changed; the copies follow it. Without -precompress,
+    // copies from an earlier run would no longer match a changed file, so they go.
+    bool commit() {
+        bool changed = file.commit();
+        if (copies) copies->commit();
+        else if (changed) CompressedCopies::remove(file.path());
+        return changed;
     }
 
-    // Text
-    if (auto* t = dynamic_cast<const TextStmtNode*>(node)) {
-        return std::make_unique<TextStmtNode>(t->text);
-    }
+private:
+    AtomicFileWriter file;
+    std::unique_ptr<CompressedCopies> copies;
+};
 
-    // Parameter
-    if (auto* p = dynamic_cast<const ParameterNode*>(node)) {
-        return std::make_unique<ParameterNode>(p->name, p->value);
-    }
+} // namespace
 
-    // Load
-    if (auto* l = dynamic_cast<const LoadStmtNode*>(node)) {
-        auto out = std::make_unique<LoadStmtNode>(l->name);
-        for (auto& param : l->parameters)
-            out->parameters.push_back(
-                std::unique_ptr<ParameterNode>(
-                    static_cast<ParameterNode*>(cloneNode(param.get()).release())
-                )
-            );
-        return out;
-    }
-
-    // Save
-    if (auto* s = dynamic_cast<const SaveStmtNode*>(node)) {
-        auto out = std::make_unique<SaveStmtNode>(s->name);
-        for (auto& c : s->body)
-            out->body.push_back(cloneNode(c.get()));
-        return out;
-    }
-
-    // Screen
-    if (auto* s = dynamic_cast<const ScreenStmtNode*>(node)) {
-        auto out = std::make_unique<ScreenStmtNode>(s->name);
-        for (auto& c : s->body)
-            out->body.push_back(cloneNode(c.get()));
-        return out;
-    }
-
-    // GenericAt
-    if (auto* g = dynamic_cast<const GenericAtStmtNode*>(node)) {
-        auto out = std::make_unique<GenericAtStmtNode>(g->name, g->value);
-        for (auto& [k, v] : g->htmlData)
-            out->htmlData.push_back(std::make_pair(k, v));
-        for (auto& c : g->body)
-            out->body.push_back(cloneNode(c.get()));
-        return out;
-    }
+// -------------------------------
+// Page Title
+// -------------------------------
+// The first @title of the page. The components loaded at the top level are searched
+// where they are loaded, as their nodes count as top-level statements too. An unknown
+// component there is an error, reported before anything is written.
+std::string_view CodeGenerator::findTitle(const NodeList& page) {
+    std::string_view found;
+    bool done = false;
+
+    std::vector<std::pair<const NodeList*, size_t>> pending{{&page, 0}};
+    while (!pending.empty()) {
+        auto& [nodes, next] = pending.back();
+        if (next == nodes->size()) {
+            pending.pop_back();
+            continue;
+        }
 
-    // Layout
-    if (auto* l = dynamic_cast<const LayoutStmtNode*>(node)) {
-        auto out = std::make_unique<LayoutStmtNode>();
-        out->bordered = true;
-        out->layout = l->layout;
-        for (auto& c : l->body)
-            out->body.push_back(cloneNode(c.get()));
-        return out;
+        const ASTNode& node = *(*nodes)[next++];
+        if (auto* load = nodeCast<const LoadStmtNode>(&node)) {
+            const Analysis::Instance* instance = analysis->instance(*load);
+            if (!instance || !instance->body) {
+                if (pending.size() == 1)
+                    throw std::runtime_error("Undefined component: @load " + std::string(symbolName(load->name)));
+                continue;
+            }
+            if (!done) pending.emplace_back(instance->body, 0);
+        } else if (auto* title = nodeCast<const TitleStmtNode>(&node)) {
+            if (!done) found = title->title;
+            done = true;
+        }
     }
-    
-
-    throw std::runtime_error("Unknown AST node type in cloneNode()");
+    return found;
 }
 
 // -------------------------------
-// Load Expander
+// Stylesheet Usage
 // -------------------------------
-void CodeGenerator::expandLoadsInList(std::vector<std::unique_ptr<ASTNode>>& list) {
-    for (size_t i = 0; i < list.size(); /* manual increment */) {
-
-        ASTNode* raw = list[i].get();
-
-        // ===========================
-        // CASE 1: @load
-        // ===========================
-        if (auto* load = dynamic_cast<LoadStmtNode*>(raw)) {
-
-            // First expand inside the load node itself if it has childrens
-            if (load->children() && !load->children()->empty()) {
-                expandLoadsInList(*load->children());
-            }
-
-            // Now find the saved template
-            auto it = atSaveTable.find(load->name);
-            if (it == atSaveTable.end()) {
-                throw std::runtime_error("Undefined component: @load " + load->name);
-            }
-
-            const auto& savedTemplate = it->second;
-
-            // Build parameter context
-            std::unordered_map<std::string, std::string> paramContext;
-            for (auto& param : load->parameters)
-                paramContext[param->name] = param->value;
-
-            // ---- Remove the load node ----
-            list.erase(list.begin() + i);
-
-            size_t insertCount = 0;
-
-            // Clone + apply params
-            for (const auto& tpl : savedTemplate) {
-
-                std::unique_ptr<ASTNode> cloned = cloneNode(tpl.get());
-
-                if (!paramContext.empty())
-                    replaceNodeValueWithAppropriateContext(cloned.get(), paramContext);
-
-                list.insert(list.begin() + i + insertCount, std::move(cloned));
-                insertCount++;
+// The classes and ids the page can put on its elements. Every reachable component
+// counts, as if it were loaded: a superset is fine for pruning.
+SelectorUsage CodeGenerator::usedSelectors(const NodeList& page) {
+    SelectorUsage used;
+
+    auto scan = [&](const NodeList& list, bool inComponent) {
+        std::vector<std::pair<const NodeList*, size_t>> pending{{&list, 0}};
+        while (!pending.empty()) {
+            auto& [nodes, next] = pending.back();
+            if (next == nodes->size()) {
+                pending.pop_back();
+                continue;
             }
 
-            i += insertCount;
-            continue;
-        }
-
-        // ===========================
-        // CASE 2: Containers
-        // ===========================
-        if (auto* screen = dynamic_cast<ScreenStmtNode*>(raw)) {
-            expandLoadsInList(screen->body);
-        }
-        else if (auto* save = dynamic_cast<SaveStmtNode*>(raw)) {
-            expandLoadsInList(save->body);
+            const ASTNode& node = *(*nodes)[next++];
+            visitNode(node, Overloaded{
+                [&](const ScreenStmtNode& screen) {
+                    used.classes.insert("screen");
+                    used.ids.insert(symbolName(screen.name));
+                    pending.emplace_back(&screen.body, 0);
+                },
+                [&](const LayoutStmtNode& layout) {
+                    used.classes.insert("layout");
+                    if (layout.bordered || inComponent) used.classes.insert("main-borders");
+                    used.ids.insert(symbolName(layout.layout));
+                    pending.emplace_back(&layout.body, 0);
+                },
+                [&](const GenericAtStmtNode& generic) {
+                    for (const auto& [k, v] : generic.htmlData) {
+                        if (symbolName(k) == "class") used.addClasses(v);
+                        else if (symbolName(k) == "id") used.ids.insert(v);
+                    }
+                },
+                [](const ASTNode&) {},
+            });
         }
+    };
 
-        i++; // default
-    }
+    scan(page, false);
+    for (Symbol name : analysis->order())
+        scan(*analysis->component(name), true);
+    return used;
 }
 
 // -------------------------------
 // Main generate()
 // -------------------------------
-void CodeGenerator::generate(RootNode& root) {
+bool CodeGenerator::generate(const Analysis& analysis) {
+    // Write through a temp file; an identical output.html is left untouched. The
+    // sink does the buffering, so the writer gets whole chunks and keeps none.
+    PageWriter outFile("output.html", precompressLevel);
+    OutputSink out([&](std::string_view chunk) { outFile.write(chunk); });
+    render(analysis, out);
+    out.flush();
+    return outFile.commit();
+}
 
-    // 1. Collect all @save blocks (without modifying them)
-    for (auto& stmt : root.statements) {
-        if (auto* save = dynamic_cast<SaveStmtNode*>(stmt.get())) {
-            // Deep-clone body to avoid ownership problems
-            std::vector<std::unique_ptr<ASTNode>> cloned;
+void CodeGenerator::reset(const Analysis& analysis) {
+    this->analysis = &analysis;
+    // Keys hold node addresses, which mean nothing for another tree
+    fragments.clear();
+    sightings.clear();
+    cacheSize = 0;
+    stats = {};
+    newline = minify ? "" : "\n";
+}
 
-            for (auto& n : save->body)
-                cloned.push_back(cloneNode(n.get()));
+void CodeGenerator::render(const Analysis& analysis, OutputSink& out) {
+    reset(analysis);
+    const NodeList& page = analysis.statements();
+    std::string_view title = findTitle(page);
 
-            atSaveTable[save->name] = std::move(cloned);
+    writeHead(title, styleTag(page, ""), out);
+    renderNodes(page, 0, page.size(), out);
+    out << "</body>" << newline << "</html>" << newline;
+}
+
+// -------------------------------
+// Split Output
+// -------------------------------
+size_t CodeGenerator::generateSplit(const Analysis& analysis, const std::string& dir, ThreadPool* pool) {
+    reset(analysis);
+    const NodeList& page = analysis.statements();
+    std::string_view title = findTitle(page);
+
+    fs::create_directories(dir);
+    const std::string style = styleTag(page, dir);
+
+    // Top-level screens, each with a file name of its own ("index" is taken)
+    struct ScreenPage {
+        size_t index;
+        std::string_view name;
+        std::string file;
+    };
+    std::vector<ScreenPage> screens;
+    std::unordered_set<std::string> taken{"index"};
+    for (size_t i = 0; i < page.size(); i++) {
+        auto* screen = nodeCast<const ScreenStmtNode>(page[i].get());
+        if (!screen) continue;
+        // Caught here rather than on a worker, before any file is written
+        for (const auto& stmt : screen->body) {
+            auto* load = nodeCast<const LoadStmtNode>(stmt.get());
+            const Analysis::Instance* instance = load ? analysis.instance(*load) : nullptr;
+            if (load && (!instance || !instance->body))
+                throw std::runtime_error("Undefined component: @load " + std::string(symbolName(load->name)));
         }
-    }
 
-    // 2. Expand @load across *all* root statements
-    expandLoadsInList(root.statements);
+        std::string name(symbolName(screen->name));
+        std::string file = name;
+        for (size_t n = 2; !taken.insert(file).second; n++)
+            file = name + "-" + std::to_string(n);
+        screens.push_back({i, symbolName(screen->name), file + ".html"});
+    }
 
-    // Create a file and stream the result of generateHTMLOutput on it
-    std::ofstream outFile("output.html");
-    if (outFile.is_open()) {
-        outFile << generateHTMLOutput(root);
-        outFile.close();
+    // Runs of neighbouring screens go to one generator each, so repeated components
+    // hit a warm fragment cache; the analysis is only read
+    const size_t batches = std::max<size_t>(1, std::min<size_t>(screens.size(), pool ? pool->size() * 4 : 1));
+    std::vector<CodeGenerator> workers(batches);
+    std::vector<char> written(screens.size(), 0);
+
+    auto renderBatch = [&](size_t batch) {
+        CodeGenerator& worker = workers[batch];
+        worker.minify = minify;
+        worker.reset(analysis);
+        size_t first = batch * screens.size() / batches;
+        size_t last = (batch + 1) * screens.size() / batches;
+        for (size_t i = first; i < last; i++) {
+            PageWriter file(dir + "/" + screens[i].file, precompressLevel);
+            OutputSink out([&](std::string_view chunk) { file.write(chunk); });
+            worker.writeHead(title, style, out);
+            worker.renderNodes(page, screens[i].index, screens[i].index + 1, out);
+            out << "</body>" << newline << "</html>" << newline;
+            out.flush();
+            written[i] = file.commit();
+        }
+    };
+    if (pool) {
+        pool->parallelFor(batches, renderBatch);
     } else {
-        std::cerr << "Error: Unable to open output.html for writing." << std::endl;
+        for (size_t batch = 0; batch < batches; batch++) renderBatch(batch);
     }
 
-
-}
-
-std::string CodeGenerator::generateHTMLOutput(RootNode& root) {
-    std::ostringstream out;
-
-    // Start HTML
-    out << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"UTF-8\">\n<title>";
-
-    // Find title node
-    for (auto& stmt : root.statements) {
-        if (auto* title = dynamic_cast<TitleStmtNode*>(stmt.get())) {
-            out << title->title;
-            break;
-        }
+    // The index: everything outside the screens, then a link to each of them
+    PageWriter file(dir + "/index.html", precompressLevel);
+    OutputSink out([&](std::string_view chunk) { file.write(chunk); });
+    writeHead(title, style, out);
+    size_t from = 0;
+    for (const auto& screen : screens) {
+        renderNodes(page, from, screen.index, out);
+        from = screen.index + 1;
     }
+    renderNodes(page, from, page.size(), out);
+
+    out << "<ul class=\"screens\">" << newline;
+    for (const auto& screen : screens)
+        out << "<li><a href=\"" << screen.file << "\">" << screen.name << "</a></li>" << newline;
+    out << "</ul>" << newline << "</body>" << newline << "</html>" << newline;
+    out.flush();
+
+    size_t changed = file.commit() ? 1 : 0;
+    for (size_t i = 0; i < screens.size(); i++) changed += written[i];
+    for (const auto& worker : workers) {
+        stats.hits += worker.stats.hits;
+        stats.misses += worker.stats.misses;
+    }
+    return changed;
+}
 
-    out << "</title>\n</head>";
-
-    // Prototyping css
-    out << "<style>\n";
-    out << readFile("style.css"); 
-    out << "</style>\n";
-
-    out << "<body>\n";
-
-    // Recursive helper lambda
-    std::function<void(const ASTNode*, const std::unordered_map<std::string, std::string>&)> renderNode;
-    renderNode = [&](const ASTNode* node, const std::unordered_map<std::string, std::string>& context) {
-        if (!node) return;
-
-        if (auto* text = dynamic_cast<const TextStmtNode*>(node)) {
-            std::string txt = text->text;
-            // Replace placeholders like {name} with context values
-            for (auto& [k, v] : context) {
-                size_t pos = 0;
-                std::string ph = "{" + k + "}";
-                while ((pos = txt.find(ph, pos)) != std::string::npos) {
-                    txt.replace(pos, ph.length(), v);
-                    pos += v.length();
-                }
-            }
-            out << "<p>" << txt << "</p>\n";
-        }
-        else if (auto* generic = dynamic_cast<const GenericAtStmtNode*>(node)) {
-            std::string html_header = generic->name;
-            std::string txt = generic->value;
-            
-            
-            // Replace placeholders like {name} with context values
-            for (auto& [k, v] : context) {
-                size_t pos = 0;
-                std::string ph = "{" + k + "}";
-                while ((pos = txt.find(ph, pos)) != std::string::npos) {
-                    txt.replace(pos, ph.length(), v);
-                    pos += v.length();
-                }
-            }
+// -------------------------------
+// Page Rendering
+// -------------------------------
+void CodeGenerator::writeHead(std::string_view title, std::string_view style, OutputSink& out) {
+    out << "<!DOCTYPE html>" << newline << "<html lang=\"en\">" << newline << "<head>" << newline
+        << "<meta charset=\"UTF-8\">" << newline << "<title>";
+    out.write(title, Escape::Text);
+    out << "</title>" << newline << "</head>";
+    out << style;
+    out << "<body>" << newline;
+}
 
-            for (auto& [k, v] : context) {
-                html_header += " " + k + "=\"" + v + "\"";
-            }
-            out << "<" << html_header;
+std::string CodeGenerator::styleTag(const NodeList& page, const std::string& dir) {
+    // The built-in stylesheet, cut down to the rules this page can use
+    std::string css = pruneStylesheet(DEFAULT_STYLESHEET, usedSelectors(page));
+    if (minify) css = minifyStylesheet(css);
+    const std::string nl(newline);
+    if (!externalStylesheet) return "<style>" + nl + css + "</style>" + nl;
+
+    // One file per distinct stylesheet, shared by every page that links it
+    std::string name = hashedStylesheetName(css);
+    PageWriter file(dir.empty() ? name : dir + "/" + name, precompressLevel);
+    file.write(css);
+    file.commit();
+    return "<link rel=\"stylesheet\" href=\"" + name + "\">" + nl;
+}
 
-            // BLAH BLAH
-            for (const auto& [k, v] : generic->htmlData) {
-                out << " " << k << "=\"" << v << "\"";
-            }
+void CodeGenerator::renderNodes(const NodeList& page, size_t first, size_t last, OutputSink& out) {
+    if (first == last) return;
+
+    // Nodes are rendered off an explicit stack of open lists instead of recursing, so
+    // nesting depth is bounded by memory. A list's closing tag is written once all of
+    // its nodes are done. A @load opens the shared body of its component with a scope
+    // for its parameters; nothing of the component is copied.
+    struct OpenList {
+        const NodeList* nodes;
+        size_t next = 0;
+        size_t end = 0;
+        std::string_view closing;
+        const Scope* scope = nullptr; // parameters in effect, none on the page itself
+        bool strict = false;          // an unknown @load here is an error
+        bool top = false;             // the page's own statements
+        size_t depth = 0;             // instances the list is inside
+        Scope own{nullptr, nullptr};  // the scope an instance opens
+        Fragment* capture = nullptr;  // where an instance being recorded goes
+        size_t captureStart = 0;      // its first byte on the tape
+    };
+    // A deque, so a scope stays put while the lists inside its instance are open
+    std::deque<OpenList> open;
+
+    auto openList = [&](const NodeList& nodes, std::string_view closing, const Scope* scope,
+                        bool strict, size_t depth) -> OpenList& {
+        OpenList& list = open.emplace_back();
+        list.nodes = &nodes;
+        list.end = nodes.size();
+        list.closing = closing;
+        list.scope = scope;
+        list.strict = strict;
+        list.depth = depth;
+        return list;
+    };
 
-            out << ">\n";
-            out << txt;
-            out << "</" << html_header << ">\n";
-        }
-        else if (auto* screen = dynamic_cast<const ScreenStmtNode*>(node)) {
-            out << "<div class=\"screen\" id=\"" << screen->name << "\">\n";
-            for (auto& stmt : screen->body)
-                renderNode(stmt.get(), context);
-            out << "</div>\n";
-        } else if (auto* layout = dynamic_cast<const LayoutStmtNode*>(node)) {
-
-            if (layout->bordered == true) {
-                out << "<div class=\"layout main-borders\" id=\"" << layout->layout << "\">\n";
+    OpenList& statements = openList(page, "", nullptr, true, 0);
+    statements.top = true;
+    statements.next = first;
+    statements.end = last;
+
+    // While an instance is recorded the sink copies everything onto the tape, and
+    // the instance takes its stretch of it when its list closes
+    std::string tape;
+    size_t recording = 0;
+    struct TeeGuard {
+        OutputSink& out;
+        ~TeeGuard() { out.tee(nullptr); }
+    } guard{out};
+
+    // Recordings that grew past the fragment size are given up; the tape keeps
+    // only what the others still need
+    auto trimTape = [&] {
+        size_t keep = tape.size();
+        for (auto& list : open) {
+            if (!list.capture) continue;
+            if (tape.size() - list.captureStart > MAX_FRAGMENT_SIZE) {
+                list.capture->tooLarge = true;
+                list.capture = nullptr;
+                recording--;
             } else {
-                out << "<div class=\"layout\" id=\"" << layout->layout << "\">\n";
+                keep = std::min(keep, list.captureStart);
             }
+        }
+        tape.erase(0, keep);
+        for (auto& list : open)
+            if (list.capture) list.captureStart -= keep;
+        if (recording == 0) out.tee(nullptr);
+    };
 
-
-            for (auto& stmt : layout->body)
-                renderNode(stmt.get(), context);
-            out << "</div>\n";
+    auto closeCapture = [&](OpenList& list) {
+        Fragment& fragment = *list.capture;
+        size_t length = tape.size() - list.captureStart;
+        if (length <= MAX_FRAGMENT_SIZE && cacheSize + length <= MAX_CACHE_SIZE) {
+            fragment.html.assign(tape, list.captureStart, length);
+            fragment.stored = true;
+            cacheSize += length;
+        } else {
+            fragment.tooLarge = true;
         }
-        else if (auto* load = dynamic_cast<const LoadStmtNode*>(node)) {
-            // Build context from parameters
-            std::unordered_map<std::string, std::string> paramContext;
-            for (auto& p : load->parameters)
-                paramContext[p->name] = p->value;
-
-            // Lookup saved nodes
-            auto it = atSaveTable.find(load->name);
-            if (it != atSaveTable.end()) {
-                for (auto& saved : it->second)
-                    renderNode(saved.get(), paramContext);
-            }
+        if (--recording == 0) {
+            out.tee(nullptr);
+            tape.clear();
         }
-        else if (auto* save = dynamic_cast<const SaveStmtNode*>(node)) {
-            // Usually saves are templates; don't render directly
+    };
+
+    // An instance's key: its body, then the value of each slot it reads, as that
+    // slot renders in the instance's scope (length-suffixed, and flagged if unbound)
+    std::string key;
+    OutputSink keySink([&](std::string_view chunk) { key.append(chunk); }, 256);
+    auto makeKey = [&](const Analysis::Instance& instance, const Scope& scope) {
+        key.assign(reinterpret_cast<const char*>(&instance.body), sizeof instance.body);
+        for (uint32_t slot : *instance.reads) {
+            size_t start = key.size();
+            bool bound = renderSlot(slot, keySink, &scope);
+            keySink.flush();
+            uint64_t length = key.size() - start;
+            key.push_back(bound ? 'b' : 'u');
+            key.append(reinterpret_cast<const char*>(&length), sizeof length);
         }
     };
 
-    // Render all root statements except @save and @title
-    for (auto& stmt : root.statements) {
-        if (!dynamic_cast<SaveStmtNode*>(stmt.get()) && !dynamic_cast<TitleStmtNode*>(stmt.get()))
-            renderNode(stmt.get(), {});
-    }
+    while (!open.empty()) {
+        if (recording && tape.size() > 2 * MAX_FRAGMENT_SIZE) trimTape();
+
+        OpenList& top = open.back();
+        if (top.next == top.end) {
+            if (!top.closing.empty()) out << top.closing << newline;
+            if (top.capture) closeCapture(top);
+            open.pop_back();
+            continue;
+        }
+        const ASTNode& current = *(*top.nodes)[top.next++];
+        const Scope* scope = top.scope;
+        const bool strict = top.strict;
+        const bool atTop = top.top;
+        const size_t depth = top.depth;
+
+        // Strings inside a component go through its compiled templates; either way
+        // the page's text is escaped, parameter values included
+        auto write = [&](const ASTNode& node, std::string_view text) {
+            const TextTemplate* compiled = scope ? analysis->text(node) : nullptr;
+            if (compiled) compiled->render(out, scope, Escape::Text);
+            else out.write(text, Escape::Text);
+        };
+
+        visitNode(current, Overloaded{
+            [&](const TextStmtNode& text) {
+                out << "<p>";
+                write(text, text.text);
+                out << "</p>" << newline;
+            },
+            [&](const GenericAtStmtNode& generic) {
+                std::string_view html_header = symbolName(generic.name);
+                out << "<" << html_header;
+
+                // BLAH BLAH
+                for (const auto& [k, v] : generic.htmlData) {
+                    out << " " << symbolName(k) << "=\"";
+                    out.write(v, Escape::Attribute);
+                    out << "\"";
+                }
 
-    out << "</body>\n</html>\n";
+                out << ">" << newline;
+                write(generic, generic.value);
+                out << "</" << html_header << ">" << newline;
+            },
+            [&](const ScreenStmtNode& screen) {
+                out << "<div class=\"screen\" id=\"" << symbolName(screen.name) << "\">" << newline;
+                // Only the page's own screens insist that what they load exists
+                openList(screen.body, "</div>", scope, atTop, depth);
+            },
+            [&](const LayoutStmtNode& layout) {
+                // Layouts that come from a component are drawn bordered
+                if (layout.bordered == true || scope) {
+                    out << "<div class=\"layout main-borders\" id=\"" << symbolName(layout.layout) << "\">" << newline;
+                } else {
+                    out << "<div class=\"layout\" id=\"" << symbolName(layout.layout) << "\">" << newline;
+                }
+                openList(layout.body, "</div>", scope, false, depth);
+            },
+            [&](const LoadStmtNode& load) {
+                const Analysis::Instance* instance = analysis->instance(load);
+                if (!instance || !instance->body) {
+                    if (strict)
+                        throw std::runtime_error("Undefined component: @load " + std::string(symbolName(load.name)));
+                    return; // elsewhere, unknown components render nothing
+                }
+                // A @load without values binds nothing, so inside a component it keeps
+                // the scope it is in: a long chain of them would otherwise make every
+                // placeholder lookup below walk the whole chain
+                const bool sameScope = instance->bindings.empty() && scope;
+                Scope own{&instance->bindings, scope};
+                Fragment* capture = nullptr;
+                if (depth < MAX_CACHED_DEPTH) {
+                    makeKey(*instance, sameScope ? *scope : own);
+                    auto cached = fragments.find(key);
+                    if (cached != fragments.end()) {
+                        if (cached->second.stored) {
+                            stats.hits++;
+                            out << cached->second.html;
+                            return;
+                        }
+                    } else if (!sightings.insert(ContentHash::of(key)).second &&
+                               cacheSize + key.size() <= MAX_CACHE_SIZE) {
+                        // Seen before: record this one, so one-off instances cost no copy
+                        capture = &fragments.emplace(key, Fragment{}).first->second;
+                        cacheSize += key.size();
+                    }
+                }
+                stats.misses++;
 
-    return out.str();
+                OpenList& list = openList(*instance->body, "", scope, false, depth + 1);
+                if (!sameScope) {
+                    list.own = own;
+                    list.scope = &list.own;
+                }
+                if (capture) {
+                    if (recording++ == 0) out.tee(&tape);
+                    list.capture = capture;
+                    list.captureStart = tape.size();
+                }
+            },
+            [](const ASTNode&) {
+                // Saves are templates and titles go in <head>; neither is rendered here
+            },
+        });
+    }
 }
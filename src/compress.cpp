@@ -0,0 +1,166 @@
+#include "compress.hpp"
+#include "fileio.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#ifdef EAML_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EAML_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace {
+
+constexpr size_t OUT_BUFFER_SIZE = 64 * 1024;
+
+#ifdef EAML_HAVE_ZLIB
+// One gzip member, deflated as the data comes. The header carries no name or time,
+// so the same input always gives the same bytes.
+class GzipStream {
+public:
+    GzipStream(const std::string& path, int level) : file(path + ".gz", 0), buffer(OUT_BUFFER_SIZE) {
+        if (deflateInit2(&z, std::clamp(level, 1, 9), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Unable to start gzip stream for " + file.path());
+    }
+    ~GzipStream() { deflateEnd(&z); }
+
+    void write(std::string_view data) {
+        // Fed in pieces zlib's uInt can count
+        while (!data.empty()) {
+            size_t n = std::min<size_t>(data.size(), 1u << 30);
+            z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+            z.avail_in = static_cast<uInt>(n);
+            pump(Z_NO_FLUSH);
+            data.remove_prefix(n);
+        }
+    }
+
+    bool commit() {
+        z.next_in = nullptr;
+        z.avail_in = 0;
+        pump(Z_FINISH);
+        return file.commit();
+    }
+
+private:
+    void pump(int flush) {
+        int result;
+        do {
+            z.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            z.avail_out = static_cast<uInt>(buffer.size());
+            result = deflate(&z, flush);
+            if (result == Z_STREAM_ERROR)
+                throw std::runtime_error("Unable to compress " + file.path());
+            file.write(std::string_view(buffer.data(), buffer.size() - z.avail_out));
+        } while (z.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+    }
+
+    AtomicFileWriter file;
+    std::vector<char> buffer;
+    z_stream z{};
+};
+#endif
+
+#ifdef EAML_HAVE_BROTLI
+class BrotliStream {
+public:
+    BrotliStream(const std::string& path, int level) : file(path + ".br", 0) {
+        state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!state) throw std::runtime_error("Unable to start brotli stream for " + file.path());
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(std::clamp(level, 1, 11)));
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    }
+    ~BrotliStream() { BrotliEncoderDestroyInstance(state); }
+
+    void write(std::string_view data) { pump(BROTLI_OPERATION_PROCESS, data); }
+
+    bool commit() {
+        pump(BROTLI_OPERATION_FINISH, {});
+        return file.commit();
+    }
+
+private:
+    void pump(BrotliEncoderOperation op, std::string_view data) {
+        size_t availableIn = data.size();
+        auto* nextIn = reinterpret_cast<const uint8_t*>(data.data());
+        do {
+            size_t availableOut = 0;
+            if (!BrotliEncoderCompressStream(state, op, &availableIn, &nextIn, &availableOut, nullptr, nullptr))
+                throw std::runtime_error("Unable to compress " + file.path());
+            // Output is taken straight from the encoder's own buffer
+            while (BrotliEncoderHasMoreOutput(state)) {
+                size_t size = 0;
+                const uint8_t* out = BrotliEncoderTakeOutput(state, &size);
+                file.write(std::string_view(reinterpret_cast<const char*>(out), size));
+            }
+        } while (availableIn > 0 || (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state)));
+    }
+
+    AtomicFileWriter file;
+    BrotliEncoderState* state = nullptr;
+};
+#endif
+
+} // namespace
+
+struct CompressedCopies::Streams {
+#ifdef EAML_HAVE_ZLIB
+    std::optional<GzipStream> gzip;
+#endif
+#ifdef EAML_HAVE_BROTLI
+    std::optional<BrotliStream> brotli;
+#endif
+};
+
+std::string_view CompressedCopies::formats() {
+#if defined(EAML_HAVE_ZLIB) && defined(EAML_HAVE_BROTLI)
+    return ".gz .br";
+#elif defined(EAML_HAVE_ZLIB)
+    return ".gz";
+#elif defined(EAML_HAVE_BROTLI)
+    return ".br";
+#else
+    return "";
+#endif
+}
+
+void CompressedCopies::remove(const std::string& path) {
+    for (const char* extension : {".gz", ".br"})
+        std::remove((path + extension).c_str());
+}
+
+CompressedCopies::CompressedCopies([[maybe_unused]] const std::string& path, [[maybe_unused]] int level)
+    : streams(std::make_unique<Streams>()) {
+#ifdef EAML_HAVE_ZLIB
+    streams->gzip.emplace(path, level);
+#endif
+#ifdef EAML_HAVE_BROTLI
+    streams->brotli.emplace(path, level);
+#endif
+}
+
+CompressedCopies::~CompressedCopies() = default;
+
+void CompressedCopies::write([[maybe_unused]] std::string_view data) {
+#ifdef EAML_HAVE_ZLIB
+    streams->gzip->write(data);
+#endif
+#ifdef EAML_HAVE_BROTLI
+    streams->brotli->write(data);
+#endif
+}
+
+size_t CompressedCopies::commit() {
+    size_t changed = 0;
+#ifdef EAML_HAVE_ZLIB
+    changed += streams->gzip->commit();
+#endif
+#ifdef EAML_HAVE_BROTLI
+    changed += streams->brotli->commit();
+#endif
+    return changed;
+}
@@ -0,0 +1,352 @@
+#include "codegen.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+#include "fileio.hpp"
+
+// -------------------------------
+// C++ Output
+// -------------------------------
+// Each reachable component becomes
+//
+//     struct component_card_args { Arg age; Arg name; };
+//     inline void component_card(std::string& out, const component_card_args& args);
+//
+// with an argument for each placeholder its output takes from where it is loaded
+// (those of the components it loads included, unless the @load binds them), in
+// order of name. An argument holds the value as the HTML back end would fill it in;
+// nullopt leaves the placeholder as written. Arguments come in a struct so a @load
+// with constant values passes a constant, not a long list of temporaries. Everything
+// that doesn't depend on the arguments is rendered here, once, into string constants.
+
+namespace {
+
+// Longest string constant emitted in one piece, well inside what compilers accept
+constexpr size_t MAX_LITERAL = 4096;
+
+// bytes as a string_view literal; anything but printable ASCII goes in as an octal
+// escape, so the bytes come out exactly as they went in
+void appendLiteral(std::string& code, std::string_view bytes) {
+    code += '"';
+    for (unsigned char c : bytes) {
+        switch (c) {
+            case '"': code += "\\\""; break;
+            case '\\': code += "\\\\"; break;
+            case '\n': code += "\\n"; break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    char escape[5];
+                    std::snprintf(escape, sizeof escape, "\\%03o", c);
+                    code += escape;
+                } else {
+                    code += static_cast<char>(c);
+                }
+        }
+    }
+    code += "\"sv";
+}
+
+std::string literal(std::string_view bytes) {
+    std::string code;
+    appendLiteral(code, bytes);
+    return code;
+}
+
+bool isKeyword(std::string_view word) {
+    static const std::unordered_set<std::string_view> keywords{
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+        "catch", "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr", "const_cast",
+        "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+        "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int",
+        "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+        "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+        "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+        "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+        "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+        // and what the generated code itself uses
+        "out", "Arg", "std", "eaml"};
+    return keywords.count(word) != 0;
+}
+
+// prefix + name with anything that can't go in an identifier turned into '_' (and
+// "arg_" in front of what still isn't one), and a number added if that is taken
+std::string identifier(std::string_view prefix, std::string_view name, std::unordered_set<std::string>& taken) {
+    std::string base(prefix);
+    for (char c : name) base += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    if (base.empty() || std::isdigit(static_cast<unsigned char>(base[0])) || base[0] == '_' || isKeyword(base))
+        base.insert(0, "arg_");
+    std::string id = base;
+    for (size_t n = 2; !taken.insert(id).second; n++)
+        id = base + "_" + std::to_string(n);
+    return id;
+}
+
+// The body of one function. Static HTML is rendered into a buffer as it comes and
+// goes out as constants just before the next statement that needs the arguments.
+class FunctionWriter {
+public:
+    explicit FunctionWriter(std::string& code)
+        : code(code), sink([this](std::string_view chunk) { html.append(chunk); }) {}
+
+    OutputSink& out() { return sink; }
+
+    // A statement that depends on the arguments, indented to the function body
+    void statement(std::string_view line) {
+        flushHtml();
+        code.append("    ").append(line).append("\n");
+        empty = false;
+    }
+
+    void finish() {
+        flushHtml();
+        if (empty) code += "    (void)out;\n"; // a component with nothing to show
+    }
+
+private:
+    void flushHtml() {
+        sink.flush();
+        for (size_t i = 0; i < html.size(); i += MAX_LITERAL) {
+            code += "    out += ";
+            appendLiteral(code, std::string_view(html).substr(i, MAX_LITERAL));
+            code += ";\n";
+            empty = false;
+        }
+        html.clear();
+    }
+
+    std::string& code;
+    std::string html;
+    OutputSink sink;
+    bool empty = true;
+};
+
+// What the functions are called and what their arguments are, page-wide
+struct Names {
+    std::unordered_map<Symbol, std::string> components;
+    std::unordered_map<Symbol, std::string> argumentTypes;
+    std::unordered_map<Symbol, std::vector<uint32_t>> parameters; // in argument order
+    std::unordered_map<uint32_t, std::string> arguments;          // by slot
+
+    std::string argument(uint32_t slot) const { return "args." + arguments.at(slot); }
+};
+
+// Code for top-level statements [first, last) of nodes, or a component body. It
+// follows CodeGenerator::renderNodes() step for step; inComponent is whether the
+// arguments of a component are in scope.
+void emitNodes(const Analysis& analysis, const Names& names, std::string_view newline, const NodeList& nodes,
+               size_t first, size_t last, bool inComponent, FunctionWriter& fn) {
+    struct OpenList {
+        const NodeList* nodes;
+        size_t next;
+        size_t end;
+        std::string_view closing;
+        bool strict;
+        bool top;
+    };
+    std::vector<OpenList> open{{&nodes, first, last, "", !inComponent, !inComponent}};
+    OutputSink& out = fn.out();
+    size_t temporaries = 0;
+
+    // Appends the text of a template in this scope: literal runs are written now,
+    // placeholders become reads of the arguments
+    auto writeTemplate = [&](const TextTemplate& text) {
+        for (const auto& part : text.parts()) {
+            if (part.slot == SlotTable::NONE) {
+                out.write(part.text, Escape::Text);
+                continue;
+            }
+            fn.statement("writeEscaped(out, " + names.argument(part.slot) + ".value_or(" + literal(part.text) + "));");
+        }
+    };
+
+    while (!open.empty()) {
+        OpenList& top = open.back();
+        if (top.next == top.end) {
+            if (!top.closing.empty()) out << top.closing << newline;
+            open.pop_back();
+            continue;
+        }
+        const ASTNode& current = *(*top.nodes)[top.next++];
+        const bool strict = top.strict;
+        const bool atTop = top.top;
+
+        auto write = [&](const ASTNode& node, std::string_view text) {
+            const TextTemplate* compiled = inComponent ? analysis.text(node) : nullptr;
+            if (compiled) writeTemplate(*compiled);
+            else out.write(text, Escape::Text);
+        };
+
+        visitNode(current, Overloaded{
+            [&](const TextStmtNode& text) {
+                out << "<p>";
+                write(text, text.text);
+                out << "</p>" << newline;
+            },
+            [&](const GenericAtStmtNode& generic) {
+                std::string_view html_header = symbolName(generic.name);
+                out << "<" << html_header;
+                for (const auto& [k, v] : generic.htmlData) {
+                    out << " " << symbolName(k) << "=\"";
+                    out.write(v, Escape::Attribute);
+                    out << "\"";
+                }
+                out << ">" << newline;
+                write(generic, generic.value);
+                out << "</" << html_header << ">" << newline;
+            },
+            [&](const ScreenStmtNode& screen) {
+                out << "<div class=\"screen\" id=\"" << symbolName(screen.name) << "\">" << newline;
+                open.push_back({&screen.body, 0, screen.body.size(), "</div>", atTop, false});
+            },
+            [&](const LayoutStmtNode& layout) {
+                if (layout.bordered == true || inComponent) {
+                    out << "<div class=\"layout main-borders\" id=\"" << symbolName(layout.layout) << "\">" << newline;
+                } else {
+                    out << "<div class=\"layout\" id=\"" << symbolName(layout.layout) << "\">" << newline;
+                }
+                open.push_back({&layout.body, 0, layout.body.size(), "</div>", false, false});
+            },
+            [&](const LoadStmtNode& load) {
+                const Analysis::Instance* instance = analysis.instance(load);
+                if (!instance || !instance->body) {
+                    if (strict)
+                        throw std::runtime_error("Undefined component: @load " + std::string(symbolName(load.name)));
+                    return;
+                }
+
+                // Each argument: the @load's value for it, filled in here (outside of a
+                // component that is the value as written), or else what this scope has
+                Scope bound{&instance->bindings, nullptr};
+                std::string setup;
+                std::string fields;
+                bool constant = true;
+                for (uint32_t slot : names.parameters.at(load.name)) {
+                    if (!fields.empty()) fields += ", ";
+                    const TextTemplate* value = bound.find(slot);
+                    if (value && (!inComponent || !value->hasSlots())) {
+                        fields += literal(value->source());
+                    } else if (value) {
+                        std::string temporary = "value" + std::to_string(temporaries++);
+                        setup += "std::string " + temporary + ";";
+                        for (const auto& part : value->parts()) {
+                            setup += " " + temporary + " += ";
+                            if (part.slot == SlotTable::NONE) setup += literal(part.text);
+                            else setup += names.argument(part.slot) + ".value_or(" + literal(part.text) + ")";
+                            setup += ";";
+                        }
+                        fields += temporary;
+                        constant = false;
+                    } else if (inComponent) {
+                        fields += names.argument(slot);
+                        constant = false;
+                    } else {
+                        fields += "std::nullopt";
+                    }
+                }
+                fn.statement("{ " + setup + (constant ? "static constexpr " : "") + names.argumentTypes.at(load.name) +
+                             " next{" + fields + "}; " + names.components.at(load.name) + "(out, next); }");
+            },
+            [](const ASTNode&) {},
+        });
+    }
+}
+
+} // namespace
+
+bool CodeGenerator::generateCpp(const Analysis& analysis, const std::string& path) {
+    reset(analysis);
+    const NodeList& page = analysis.statements();
+    std::string_view title = findTitle(page);
+
+    // Names first: a component's function is called before its own code is written
+    Names names;
+    std::unordered_set<std::string> taken{"page", "writeEscaped"};
+    std::unordered_set<std::string> arguments;
+    for (Symbol component : analysis.order()) {
+        const std::string& function = names.components[component] =
+            identifier("component_", symbolName(component), taken);
+        names.argumentTypes.emplace(component, identifier("", function + "_args", taken));
+        std::vector<uint32_t> params = analysis.parameters(component);
+        for (uint32_t slot : params) {
+            if (!names.arguments.count(slot))
+                names.arguments.emplace(slot, identifier("", symbolName(analysis.placeholder(slot)), arguments));
+        }
+        std::sort(params.begin(), params.end(),
+                  [&](uint32_t a, uint32_t b) { return names.arguments[a] < names.arguments[b]; });
+        names.parameters.emplace(component, std::move(params));
+    }
+
+    std::string code;
+    code += "// Generated by eaml; do not edit. Every component and top-level screen of the\n"
+            "// page is a function that appends its HTML to out, and page() writes the\n"
+            "// whole document, as the HTML back end would.\n"
+            "#pragma once\n"
+            "#include <optional>\n"
+            "#include <string>\n"
+            "#include <string_view>\n"
+            "\n"
+            "namespace eaml {\n"
+            "\n"
+            "using namespace std::string_view_literals;\n"
+            "\n"
+            "// The value of a placeholder; nullopt leaves it as written\n"
+            "using Arg = std::optional<std::string_view>;\n"
+            "\n"
+            "inline void writeEscaped(std::string& out, std::string_view text) {\n"
+            "    for (char c : text) {\n"
+            "        switch (c) {\n"
+            "            case '&': out += \"&amp;\"; break;\n"
+            "            case '<': out += \"&lt;\"; break;\n"
+            "            case '>': out += \"&gt;\"; break;\n"
+            "            default: out += c; break;\n"
+            "        }\n"
+            "    }\n"
+            "}\n";
+
+    // Components, each after the ones it loads
+    for (Symbol component : analysis.order()) {
+        const std::string& type = names.argumentTypes.at(component);
+        code += "\n// @save " + std::string(symbolName(component)) + "\n";
+        code += "struct " + type + " {";
+        for (uint32_t slot : names.parameters.at(component)) code += " Arg " + names.arguments.at(slot) + ";";
+        code += " };\n";
+        code += "inline void " + names.components.at(component) + "(std::string& out, [[maybe_unused]] const " +
+                type + "& args) {\n";
+        const NodeList& body = *analysis.component(component);
+        FunctionWriter fn(code);
+        emitNodes(analysis, names, newline, body, 0, body.size(), true, fn);
+        fn.finish();
+        code += "}\n";
+    }
+
+    // Top-level screens
+    std::vector<std::string> screens(page.size());
+    for (size_t i = 0; i < page.size(); i++) {
+        auto* screen = nodeCast<const ScreenStmtNode>(page[i].get());
+        if (!screen) continue;
+        screens[i] = identifier("screen_", symbolName(screen->name), taken);
+        code += "\n// @screen " + std::string(symbolName(screen->name)) + "\n";
+        code += "inline void " + screens[i] + "(std::string& out) {\n";
+        FunctionWriter fn(code);
+        emitNodes(analysis, names, newline, page, i, i + 1, false, fn);
+        fn.finish();
+        code += "}\n";
+    }
+
+    code += "\n// The whole page\ninline void page(std::string& out) {\n";
+    FunctionWriter fn(code);
+    writeHead(title, styleTag(page, ""), fn.out());
+    for (size_t i = 0; i < page.size(); i++) {
+        if (!screens[i].empty()) fn.statement(screens[i] + "(out);");
+        else emitNodes(analysis, names, newline, page, i, i + 1, false, fn);
+    }
+    fn.out() << "</body>" << newline << "</html>" << newline;
+    fn.finish();
+    code += "}\n\n} // namespace eaml\n";
+
+    AtomicFileWriter file(path, 0);
+    file.write(code);
+    return file.commit();
+}
@@ -0,0 +1,270 @@
+#include "fileio.hpp"
+#include "scan.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <process.h>
+#define eaml_open _open
+#define eaml_write _write
+#define eaml_close _close
+#define eaml_getpid _getpid
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#define eaml_open ::open
+#define eaml_write ::write
+#define eaml_close ::close
+#define eaml_getpid ::getpid
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Writes all of data, retrying short writes
+static void writeAll(int fd, std::string_view data, const std::string& path) {
+    while (!data.empty()) {
+        auto n = eaml_write(fd, data.data(), static_cast<unsigned>(std::min<size_t>(data.size(), 1u << 30)));
+        if (n < 0)
+            throw std::runtime_error("Unable to write " + path + ": " + std::strerror(errno));
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+// -------------------------------
+// MappedFile
+// -------------------------------
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Unable to open " + path);
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("Unable to stat " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    if (size > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    CloseHandle(file);
+
+    if (size > 0 && !data) {
+        release();
+        throw std::runtime_error("Unable to map " + path);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open " + path + ": " + std::strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Unable to stat " + path + ": " + std::strerror(errno));
+    }
+    size = static_cast<size_t>(st.st_size);
+
+    // mmap refuses zero-length mappings; an empty file is just an empty view
+    if (size > 0) {
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Unable to map " + path + ": " + std::strerror(errno));
+        }
+        madvise(p, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(p);
+    }
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        data = other.data;
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+#ifdef _WIN32
+        mapping = other.mapping;
+        other.mapping = nullptr;
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    if (data) munmap(const_cast<char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// -------------------------------
+// AtomicFileWriter
+// -------------------------------
+AtomicFileWriter::AtomicFileWriter(std::string path, size_t bufferSize)
+    : target(std::move(path)), buffer(bufferSize) {
+    tempPath = target + ".tmp" + std::to_string(eaml_getpid());
+    fd = eaml_open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open " + tempPath + " for writing: " + std::strerror(errno));
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    discard();
+}
+
+void AtomicFileWriter::write(std::string_view data) {
+    hash.update(data);
+    written += data.size();
+
+    if (used + data.size() <= buffer.size()) {
+        std::memcpy(buffer.data() + used, data.data(), data.size());
+        used += data.size();
+        return;
+    }
+
+    flush();
+
+    // Too big to be worth buffering: hand it to the kernel directly
+    if (data.size() >= buffer.size()) {
+        writeAll(fd, data, tempPath);
+        return;
+    }
+
+    std::memcpy(buffer.data(), data.data(), data.size());
+    used = data.size();
+}
+
+void AtomicFileWriter::flush() {
+    writeAll(fd, std::string_view(buffer.data(), used), tempPath);
+    used = 0;
+}
+
+bool AtomicFileWriter::commit() {
+    if (fd < 0)
+        throw std::runtime_error("AtomicFileWriter::commit() called twice for " + target);
+
+    flush();
+    eaml_close(fd);
+    fd = -1;
+
+    // Same bytes already on disk: keep the old file and its timestamp
+    bool unchanged = false;
+    try {
+        MappedFile existing(target);
+        unchanged = existing.view().size() == written && ContentHash::of(existing.view()) == hash.digest();
+    } catch (const std::runtime_error&) {
+        // No previous output
+    }
+
+    if (unchanged) {
+        std::remove(tempPath.c_str());
+        tempPath.clear();
+        return false;
+    }
+
+#ifdef _WIN32
+    bool renamed = MoveFileExA(tempPath.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(tempPath.c_str(), target.c_str()) == 0;
+#endif
+    if (!renamed) {
+        std::string reason = std::strerror(errno);
+        discard();
+        throw std::runtime_error("Unable to replace " + target + ": " + reason);
+    }
+
+    tempPath.clear();
+    return true;
+}
+
+void AtomicFileWriter::discard() {
+    if (fd >= 0) {
+        eaml_close(fd);
+        fd = -1;
+    }
+    if (!tempPath.empty()) {
+        std::remove(tempPath.c_str());
+        tempPath.clear();
+    }
+}
+
+// -------------------------------
+// OutputSink
+// -------------------------------
+OutputSink::OutputSink(std::function<void(std::string_view)> consumer, size_t bufferSize)
+    : consumer(std::move(consumer)), buffer(bufferSize) {}
+
+void OutputSink::flush() {
+    if (used == 0) return;
+    consumer(std::string_view(buffer.data(), used));
+    used = 0;
+}
+
+void OutputSink::write(std::string_view data, Escape context) {
+    if (context == Escape::None) {
+        write(data);
+        return;
+    }
+
+    static const scan::Kernels& kernels = scan::best();
+    const auto find = context == Escape::Text ? kernels.htmlText : kernels.htmlAttribute;
+
+    const char* p = data.data();
+    const char* end = p + data.size();
+    while (p < end) {
+        const char* stop = find(p, end);
+        if (stop != p) write(std::string_view(p, stop - p));
+        if (stop == end) break;
+
+        switch (*stop) {
+            case '&': write("&amp;"); break;
+            case '<': write("&lt;"); break;
+            case '>': write("&gt;"); break;
+            case '"': write("&quot;"); break;
+            default: write("&#39;"); break;
+        }
+        p = stop + 1;
+    }
+}
+
+void OutputSink::spill(std::string_view data) {
+    flush();
+    if (data.size() >= buffer.size()) {
+        consumer(data);
+    } else {
+        std::memcpy(buffer.data(), data.data(), data.size());
+        used = data.size();
+    }
+}
@@ -0,0 +1,87 @@
+#include "incremental.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <iterator>
+
+const RootNode& IncrementalCompiler::update(std::string newSource, ThreadPool* pool) {
+    // Every top-level statement starts its own block
+    std::vector<SourceSplit> splits = findTopLevelSplits(newSource, 0);
+
+    std::vector<Block> newBlocks(splits.size());
+    for (size_t i = 0; i < splits.size(); i++) {
+        size_t end = i + 1 < splits.size() ? splits[i + 1].offset : newSource.size();
+        newBlocks[i] = Block{splits[i].offset, end - splits[i].offset, 0, nullptr};
+    }
+
+    auto newText = [&](size_t i) {
+        return std::string_view(newSource).substr(newBlocks[i].offset, newBlocks[i].length);
+    };
+
+    // Unchanged blocks at both ends are kept, everything in between is parsed again
+    size_t prefix = 0;
+    while (prefix < blocks.size() && prefix < newBlocks.size() &&
+           blockText(blocks[prefix]) == newText(prefix)) {
+        prefix++;
+    }
+
+    size_t suffix = 0;
+    while (suffix < blocks.size() - prefix && suffix < newBlocks.size() - prefix &&
+           blockText(blocks[blocks.size() - 1 - suffix]) == newText(newBlocks.size() - 1 - suffix)) {
+        suffix++;
+    }
+
+    // Parse the changed blocks first so an error leaves the previous tree intact
+    const size_t changed = newBlocks.size() - prefix - suffix;
+    std::vector<std::unique_ptr<RootNode>> parsed(changed);
+    auto parseBlock = [&](size_t i) {
+        size_t b = prefix + i;
+        newBlocks[b].arena = std::make_unique<Arena>(newBlocks[b].length * 4);
+        Arena::Scope scope(*newBlocks[b].arena);
+
+        // Nodes point into the text, which must not depend on the whole source staying around
+        Lexer lexer(newBlocks[b].arena->copy(newText(b)), splits[b].line);
+        Parser parser(lexer);
+        parsed[i] = parser.parseProgram();
+    };
+
+    if (pool) {
+        pool->parallelFor(changed, parseBlock);
+    } else {
+        for (size_t i = 0; i < changed; i++) parseBlock(i);
+    }
+
+    // Splice: old prefix statements, fresh ones, old suffix statements
+    size_t prefixStatements = 0;
+    for (size_t i = 0; i < prefix; i++) prefixStatements += blocks[i].statements;
+    size_t suffixStatements = 0;
+    for (size_t i = blocks.size() - suffix; i < blocks.size(); i++) suffixStatements += blocks[i].statements;
+
+    NodeList statements(std::pmr::new_delete_resource());
+    auto& old = root.statements;
+    statements.reserve(prefixStatements + suffixStatements);
+
+    std::move(old.begin(), old.begin() + prefixStatements, std::back_inserter(statements));
+    for (size_t i = 0; i < changed; i++) {
+        newBlocks[prefix + i].statements = parsed[i]->statements.size();
+        std::move(parsed[i]->statements.begin(), parsed[i]->statements.end(), std::back_inserter(statements));
+    }
+    std::move(old.end() - suffixStatements, old.end(), std::back_inserter(statements));
+
+    for (size_t i = 0; i < prefix; i++) {
+        newBlocks[i].statements = blocks[i].statements;
+        newBlocks[i].arena = std::move(blocks[i].arena);
+    }
+    for (size_t i = 0; i < suffix; i++) {
+        Block& kept = newBlocks[newBlocks.size() - 1 - i];
+        kept.statements = blocks[blocks.size() - 1 - i].statements;
+        kept.arena = std::move(blocks[blocks.size() - 1 - i].arena);
+    }
+
+    // Dropped statements are destroyed before the arenas of their old blocks
+    root.statements = std::move(statements);
+    blocks = std::move(newBlocks);
+    source = std::move(newSource);
+
+    lastStats = Stats{blocks.size(), changed};
+    return root;
+}
@@ -0,0 +1,68 @@
+#include "interner.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+Interner::Interner() {
+    // Reserve 0 for the empty name: shard 0, index 0
+    Shard& first = shards[0];
+    first.pages[0].reset(new std::string_view[PAGE_SIZE]);
+    first.pages[0][0] = std::string_view();
+    first.lookup.emplace(std::string_view(), 0);
+    first.count = 1;
+}
+
+Interner& Interner::global() {
+    static Interner interner;
+    return interner;
+}
+
+std::string_view Interner::store(Shard& shard, std::string_view name) {
+    if (name.size() > shard.charsLeft) {
+        size_t size = std::max(CHAR_BLOCK, name.size());
+        shard.chars.emplace_back(new char[size]);
+        shard.nextChar = shard.chars.back().get();
+        shard.charsLeft = size;
+    }
+
+    char* dest = shard.nextChar;
+    std::memcpy(dest, name.data(), name.size());
+    shard.nextChar += name.size();
+    shard.charsLeft -= name.size();
+    return std::string_view(dest, name.size());
+}
+
+Symbol Interner::intern(std::string_view name) {
+    if (name.empty()) return 0;
+
+    const size_t hash = std::hash<std::string_view>()(name);
+    const unsigned shardIndex = static_cast<unsigned>(hash >> 7) & (SHARDS - 1);
+    Shard& shard = shards[shardIndex];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.lookup.find(name);
+    if (it != shard.lookup.end()) return it->second;
+
+    const size_t index = shard.count;
+    if ((index >> PAGE_BITS) >= MAX_PAGES)
+        throw std::runtime_error("Too many distinct names");
+
+    auto& page = shard.pages[index >> PAGE_BITS];
+    if (!page) page.reset(new std::string_view[PAGE_SIZE]);
+
+    std::string_view stored = store(shard, name);
+    page[index & (PAGE_SIZE - 1)] = stored;
+    shard.count++;
+
+    const Symbol symbol = static_cast<Symbol>((index << SHARD_BITS) | shardIndex);
+    shard.lookup.emplace(stored, symbol);
+    return symbol;
+}
+
+std::string_view Interner::name(Symbol symbol) const {
+    const Shard& shard = shards[symbol & (SHARDS - 1)];
+    const size_t index = symbol >> SHARD_BITS;
+    return shard.pages[index >> PAGE_BITS][index & (PAGE_SIZE - 1)];
+}
@@ -1,13 +1,39 @@
 #include "lexer.hpp"
+#include "threadpool.hpp"
+#include "arena.hpp"
 #include <cctype>
+#include <cstring>
+#include <cstdint>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
 
-Lexer::Lexer(const std::string& source) : source(source) {}
+std::string_view Token::text() const {
+    if (!escaped) return value;
 
-std::vector<Token> Lexer::tokenize() {
-    std::vector<Token> tokens;
+    // Decoding only ever shrinks the literal
+    char* out = static_cast<char*>(Arena::current().allocate(value.size(), 1));
+    size_t length = 0;
+
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\' && i + 1 < value.size() && (value[i + 1] == '"' || value[i + 1] == '\\')) {
+            i++;
+        }
+        out[length++] = value[i];
+    }
+
+    return std::string_view(out, length);
+}
+
+Lexer::Lexer(std::string_view source, const scan::Kernels& kernels) : source(source), kernels(kernels) {}
+
+Lexer::Lexer(std::string_view source, size_t firstLine, const scan::Kernels& kernels)
+    : source(source), kernels(kernels), line(firstLine) {}
+
+Token Lexer::next() {
     const size_t len = source.length();
+    const char* base = source.data();
+    const char* end = base + len;
 
     while (pos < len) {
         char c = source[pos];
@@ -20,45 +46,32 @@ std::vector<Token> Lexer::tokenize() {
 
         /** IDENTIFIER */
         if (std::isalpha(static_cast<unsigned char>(c))) {
-            std::string id;
-
-            while (pos < len &&
-                   (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_'))
-            {
-                id += source[pos++];
-            }
+            const size_t start = pos;
+            pos = kernels.identEnd(base + pos + 1, end) - base;
 
-            auto it_builtin = BUILTIN_TOKENS.find(id);
-            if (it_builtin != BUILTIN_TOKENS.end()) {
-                tokens.push_back(Token{it_builtin->second, id, line});
-            } else {
-                tokens.push_back(Token{TokenType::IDENTIFIER, id, line});
-            }
-
-            continue;
+            std::string_view id = source.substr(start, pos - start);
+            TokenType type = lookupKeyword(id);
+            return Token{type, id, line, false, type == TokenType::IDENTIFIER ? intern(id) : 0};
         }
 
         /** NUMBER */
         if (std::isdigit(static_cast<unsigned char>(c))) {
-            std::string number;
+            const size_t start = pos;
             while (pos < len && std::isdigit(static_cast<unsigned char>(source[pos]))) {
-                number += source[pos++];
+                pos++;
             }
 
-            tokens.push_back(Token{TokenType::NUMBER, number, line});
-            continue;
+            return Token{TokenType::NUMBER, source.substr(start, pos - start), line};
         }
 
         /** INDENTATION (4 spaces = INDENT token) */
         if (c == ' ') {
+            uint32_t quad;
             if (pos + 3 < len &&
-                source[pos+1] == ' ' &&
-                source[pos+2] == ' ' &&
-                source[pos+3] == ' ')
+                (std::memcpy(&quad, base + pos, 4), quad == 0x20202020u))
             {
-                tokens.push_back(Token{TokenType::INDENT, std::nullopt, line});
                 pos += 4;
-                continue;
+                return Token{TokenType::INDENT, {}, line};
             }
 
             pos++;
@@ -75,23 +88,27 @@ std::vector<Token> Lexer::tokenize() {
                 line++;
             }
 
-            tokens.push_back(Token{TokenType::NEWLINE, std::nullopt, line});
-            continue;
+            return Token{TokenType::NEWLINE, {}, line};
         }
 
         /** STRINGS */
         if (c == '"') {
             pos++; // skip "
-            std::string value;
+            const size_t start = pos;
+            bool escaped = false;
 
             while (pos < len) {
+                // jump straight to the next '"' or '\\'
+                pos = kernels.stringStop(base + pos, end) - base;
+                if (pos >= len) break;
+
                 char s = source[pos];
 
-                // escape sequences \" and
+                // escape sequences \" and \\ are kept raw, decoded by Token::text()
                 if (s == '\\' && pos + 1 < len) {
                     char next = source[pos + 1];
                     if (next == '"' || next == '\\') {
-                        value += next;
+                        escaped = true;
                         pos += 2;
                         continue;
                     }
@@ -99,7 +116,6 @@ std::vector<Token> Lexer::tokenize() {
 
                 if (s == '"') break;
 
-                value += s;
                 pos++;
             }
 
@@ -107,8 +123,7 @@ std::vector<Token> Lexer::tokenize() {
                 throw std::runtime_error("Unterminated string literal");
 
             pos++; // skip closing "
-            tokens.push_back(Token{TokenType::STRING, value, line});
-            continue;
+            return Token{TokenType::STRING, source.substr(start, pos - 1 - start), line, escaped};
         }
 
         /** SINGLE-CHAR + AT-KEYWORDS */
@@ -117,61 +132,41 @@ std::vector<Token> Lexer::tokenize() {
             case '@': {
                 pos++;
                 if (pos >= len) {
-                    tokens.push_back(Token{TokenType::AT_IDENTIFIER, "", line});
-                    break;
+                    return Token{TokenType::AT_IDENTIFIER, "", line};
                 }
 
                 if (std::isalpha(static_cast<unsigned char>(source[pos]))) {
-                    std::string name;
+                    const size_t start = pos;
+                    pos = kernels.identEnd(base + pos + 1, end) - base;
 
-                    while (pos < len &&
-                           (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_'))
-                    {
-                        name += source[pos++];
-                    }
-
-                    auto it_at = BUILTIN_AT_TOKENS.find(name);
-                    if (it_at != BUILTIN_AT_TOKENS.end()) {
-                        tokens.push_back(Token{it_at->second, name, line});
-                    } else {
-                        tokens.push_back(Token{TokenType::AT_IDENTIFIER, name, line});
-                    }
+                    std::string_view name = source.substr(start, pos - start);
+                    TokenType type = lookupAtKeyword(name);
+                    return Token{type, name, line, false, type == TokenType::AT_IDENTIFIER ? intern(name) : 0};
                 }
 
                 break;
             }
 
             case ':':
-                tokens.push_back(Token{TokenType::COLON, ":", line});
-                pos++;
-                break;
+                return Token{TokenType::COLON, source.substr(pos++, 1), line};
 
             case ',':
-                tokens.push_back(Token{TokenType::COMMA, ",", line});
-                pos++;
-                break;
+                return Token{TokenType::COMMA, source.substr(pos++, 1), line};
 
             case '[':
-                tokens.push_back(Token{TokenType::LBRACKET, "[", line});
-                pos++;
-                break;
+                return Token{TokenType::LBRACKET, source.substr(pos++, 1), line};
 
             case ']':
-                tokens.push_back(Token{TokenType::RBRACKET, "]", line});
-                pos++;
-                break;
+                return Token{TokenType::RBRACKET, source.substr(pos++, 1), line};
 
             case '#': {
                 // comment until newline
-                while (pos < len && source[pos] != '\n') pos++;
+                pos = kernels.lineEnd(base + pos, end) - base;
                 break;
             }
 
-            case '=': {
-                tokens.push_back(Token{TokenType::EQUAL, "=", line});
-                pos++;
-                break;
-            }
+            case '=':
+                return Token{TokenType::EQUAL, source.substr(pos++, 1), line};
 
             case '{':
             case '}':
@@ -185,10 +180,203 @@ std::vector<Token> Lexer::tokenize() {
                 break;
         }
 
-        // Continue outer loop after switch
-        continue;
+        // Nothing emitted (comment, stray char), keep scanning
+    }
+
+    return Token{TokenType::END_OF_FILE, {}, line};
+}
+
+TokenBuffer Lexer::tokenize() {
+    TokenBuffer tokens;
+    // Pages run about 4-5 bytes a token, text-heavy ones far more; this guess
+    // saves most of the regrowth without holding much more than it needs
+    tokens.reserve((source.size() - pos) / 16 + 1);
+    Token tok;
+
+    do {
+        tok = next();
+        tokens.push(tok);
+    } while (tok.type != TokenType::END_OF_FILE);
+
+    return tokens;
+}
+
+// -------------------------------
+// Parallel lexing
+// -------------------------------
+std::vector<SourceSplit> findTopLevelSplits(std::string_view source, size_t minChunk, const scan::Kernels& kernels) {
+    std::vector<SourceSplit> splits{{0, 1}};
+    const char* base = source.data();
+    const char* end = base + source.size();
+    const char* p = base;
+    size_t line = 1;
+
+    // Mirrors the lexer's view of strings and comments, which are the only
+    // places where a "\n@" is not the start of a top-level statement
+    while (p < end) {
+        p = kernels.structural(p, end);
+        if (p == end) break;
+
+        if (*p == '\n') {
+            line++;
+            p++;
+            if (p < end && *p == '@' && static_cast<size_t>(p - base) - splits.back().offset >= minChunk)
+                splits.push_back(SourceSplit{static_cast<size_t>(p - base), line});
+        } else if (*p == '#') {
+            p = kernels.lineEnd(p, end);
+        } else {
+            // String literal (newlines inside it don't count as lines)
+            p++;
+            while (p < end) {
+                p = kernels.stringStop(p, end);
+                if (p == end) break;
+                if (*p == '"') {
+                    p++;
+                    break;
+                }
+                p += (p + 1 < end && (p[1] == '"' || p[1] == '\\')) ? 2 : 1;
+            }
+        }
     }
 
-    tokens.push_back(Token{TokenType::END_OF_FILE, std::nullopt, line});
+    return splits;
+}
+
+TokenBuffer Lexer::tokenizeParallel(ThreadPool& pool) {
+    static constexpr size_t MIN_CHUNK = 64 * 1024;
+
+    std::string_view rest = source.substr(pos);
+    const size_t minChunk = std::max(MIN_CHUNK, rest.size() / (pool.size() * 4));
+    std::vector<SourceSplit> splits = findTopLevelSplits(rest, minChunk, kernels);
+
+    if (splits.size() < 2)
+        return tokenize();
+
+    // Lex every chunk on its own; only the last one keeps its END_OF_FILE
+    std::vector<TokenBuffer> chunks(splits.size());
+    pool.parallelFor(splits.size(), [&](size_t i) {
+        size_t begin = splits[i].offset;
+        size_t stop = i + 1 < splits.size() ? splits[i + 1].offset : rest.size();
+        Lexer chunkLexer(rest.substr(begin, stop - begin), line - 1 + splits[i].line, kernels);
+        chunks[i] = chunkLexer.tokenize();
+    });
+
+    auto keep = [&](size_t i) { return chunks[i].size() - (i + 1 < chunks.size() ? 1 : 0); };
+    std::vector<size_t> offsets(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); i++)
+        offsets[i + 1] = offsets[i] + keep(i);
+
+    TokenBuffer tokens;
+    tokens.resize(offsets.back());
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        tokens.copyFrom(chunks[i], keep(i), offsets[i]);
+    });
+
+    line = tokens.line(tokens.size() - 1);
+    pos = source.size();
     return tokens;
 }
+
+// -------------------------------
+// Token buffer
+// -------------------------------
+void TokenBuffer::reserve(size_t count) {
+    types.reserve(count);
+    values.reserve(count);
+    lines.reserve(count);
+    payloads.reserve(count);
+}
+
+void TokenBuffer::resize(size_t count) {
+    types.resize(count);
+    values.resize(count);
+    lines.resize(count);
+    payloads.resize(count);
+}
+
+void TokenBuffer::push(const Token& token) {
+    types.push_back(token.type);
+    values.push_back(token.value);
+    lines.push_back(static_cast<uint32_t>(token.line));
+    payloads.push_back(token.type == TokenType::STRING ? token.escaped : token.symbol);
+}
+
+void TokenBuffer::copyFrom(const TokenBuffer& from, size_t count, size_t at) {
+    std::copy_n(from.types.begin(), count, types.begin() + at);
+    std::copy_n(from.values.begin(), count, values.begin() + at);
+    std::copy_n(from.lines.begin(), count, lines.begin() + at);
+    std::copy_n(from.payloads.begin(), count, payloads.begin() + at);
+}
+
+Token TokenBuffer::operator[](size_t i) const {
+    Token token{types[i], values[i], lines[i]};
+    if (token.type == TokenType::STRING) {
+        token.escaped = payloads[i] != 0;
+    } else {
+        token.symbol = payloads[i];
+    }
+    return token;
+}
+
+// -------------------------------
+// Token stream (bounded lookahead)
+// -------------------------------
+TokenStream::TokenStream(Lexer& lexer) : lexer(&lexer), ring(INITIAL_CAPACITY) {}
+
+TokenStream::TokenStream(const TokenBuffer& tokens, size_t start) : borrowed(&tokens), index(start) {
+    if (tokens.empty() || tokens.type(tokens.size() - 1) != TokenType::END_OF_FILE)
+        throw std::runtime_error("Token stream must end with END_OF_FILE");
+}
+
+void TokenStream::fill(size_t count) {
+    while (buffered < count) {
+        if (buffered == ring.size()) {
+            // Lookahead deeper than the ring (long indentation run): grow it, keeping order
+            std::vector<Token> grown(ring.size() * 2);
+            for (size_t i = 0; i < buffered; i++)
+                grown[i] = ring[(head + i) & (ring.size() - 1)];
+            ring = std::move(grown);
+            head = 0;
+        }
+
+        // Once the lexer hit END_OF_FILE, keep repeating it
+        Token tok = eof ? ring[(head + buffered - 1) & (ring.size() - 1)] : lexer->next();
+        eof = tok.type == TokenType::END_OF_FILE;
+        ring[(head + buffered) & (ring.size() - 1)] = tok;
+        buffered++;
+    }
+}
+
+TokenType TokenStream::type(size_t offset) {
+    if (borrowed) {
+        return borrowed->type(std::min(index + offset, borrowed->size() - 1));
+    }
+
+    fill(offset + 1);
+    return ring[(head + offset) & (ring.size() - 1)].type;
+}
+
+size_t TokenStream::line(size_t offset) {
+    if (borrowed) {
+        return borrowed->line(std::min(index + offset, borrowed->size() - 1));
+    }
+
+    fill(offset + 1);
+    return ring[(head + offset) & (ring.size() - 1)].line;
+}
+
+Token TokenStream::consume() {
+    if (borrowed) {
+        Token tok = (*borrowed)[std::min(index, borrowed->size() - 1)];
+        if (index < borrowed->size()) index++;
+        return tok;
+    }
+
+    fill(1);
+    Token tok = ring[head];
+    if (tok.type != TokenType::END_OF_FILE || buffered > 1) {
+        head = (head + 1) & (ring.size() - 1);
+        buffered--;
+    }
+    return tok;
+}
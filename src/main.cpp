@@ -3,12 +3,20 @@
 #include <filesystem>
 #include <thread>
 #include <chrono>
+#include <charconv>
+#include <optional>
 
 #include "codeutils.hpp"
+#include "fileio.hpp"
+#include "arena.hpp"
+#include "astcache.hpp"
+#include "incremental.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "anaylzer.hpp"
 #include "codegen.hpp"
+#include "compress.hpp"
+#include "threadpool.hpp"
 
 using namespace std::chrono_literals;
 namespace fs = std::filesystem;
@@ -22,44 +30,218 @@ void BENCHMARK(F&& func, const std::string& action) {
     std::cout << action << " took " << duration.count() << "ms\n";
 }
 
-void run(const char* path) {
-    std::string source = readFile(path);
+struct Options {
+    bool dev = false;
+    bool cache = true; // reuse/write the .eamlc AST cache next to the source
+    unsigned jobs = 1; // 0 = one per core
+    bool externalCss = false; // link a content-hashed stylesheet file instead of inlining it
+    std::string outDir;       // if set, one file per top-level screen in here
+    bool minify = false;
+    int precompress = 0;      // level of the .gz/.br copies, 0 = none
+    std::string emitCpp;      // if set, a C++ header with the page's render functions instead
+};
 
-    std::vector<Token> tokens;
-    Lexer lexer(source);
+// Back end shared by one-shot and -dev runs. Errors are printed; returns false if
+// the page couldn't be written because of one.
+bool emit(const RootNode& ast, const Options& options, ThreadPool* pool) {
+    Analysis analysis;
+    try {
+        BENCHMARK([&]() { analysis = analyzeTree(ast); }, "Analyzing AST");
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    // Not rendered and not checked, say so rather than pass over them quietly
+    if (analysis.unreachable())
+        std::cout << "Skipped " << analysis.unreachable() << " component(s) that nothing loads\n";
+
+    CodeGenerator codegen;
+    codegen.externalStylesheet = options.externalCss;
+    codegen.minify = options.minify;
+    codegen.precompressLevel = options.precompress;
+    // -emit-cpp: C++ render functions; -out-dir: one file per screen; otherwise the
+    // whole page goes to output.html
+    const bool cpp = !options.emitCpp.empty();
+    const bool split = !options.outDir.empty();
+    size_t changed = 0;
+    try {
+        if (cpp) {
+            BENCHMARK([&]() { changed = codegen.generateCpp(analysis, options.emitCpp); }, "Generating C++");
+        } else {
+            BENCHMARK([&]() {
+                changed = split ? codegen.generateSplit(analysis, options.outDir, pool) : codegen.generate(analysis);
+            }, "Generating Code");
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
 
-    BENCHMARK([&]() { tokens = lexer.tokenize(); }, "Lexing");
+    if (cpp) {
+        if (changed) std::cout << "Exported to " << options.emitCpp << "\n";
+        else std::cout << options.emitCpp << " is up to date\n";
+        return true;
+    }
+    const auto& fragments = codegen.fragmentStats();
+    if (fragments.hits + fragments.misses > 0)
+        std::cout << "Fragment cache: " << fragments.hits << " hits, " << fragments.misses << " misses\n";
+
+    printPrettyTree(&ast);
+
+    if (split)
+        std::cout << "Exported " << changed << " changed file(s) to " << options.outDir << "\n";
+    else
+        std::cout << (changed ? "Exported to output.html\n" : "output.html is up to date\n");
+    return true;
+}
 
+// One-shot compile; throws std::runtime_error if the source can't be read or parsed,
+// returns false if the page had errors
+bool run(const char* path, const Options& options, ThreadPool* pool) {
+    // Tokens (and the AST built from them) point into the mapping, keep it for the whole run
+    MappedFile input(path);
+    std::string_view source = input.view();
+
+    // Nodes, decoded strings and the back end's clones all go here
+    Arena arena;
+    Arena::Scope scope(arena);
+
+    // An up-to-date cache skips the front end; its tree points into the cache mapping
+    AstCache cache(path);
     std::unique_ptr<RootNode> ast = nullptr;
-    Parser parser(tokens);
+    if (options.cache) {
+        BENCHMARK([&]() { ast = cache.load(source); }, "Loading cached AST");
+    }
 
-    BENCHMARK([&]() { ast = parser.parseProgram(); }, "Parsing");
+    if (ast) {
+        std::cout << "Front end skipped, tree loaded from " << cache.path() << "\n";
+    } else {
+        Lexer lexer(source);
 
-    BENCHMARK([&]() { ast = analyzeTree(std::move(ast)); }, "Analyzing AST");
+        if (pool) {
+            // Lex chunks in parallel, then parse top-level blocks of the borrowed buffer in parallel
+            TokenBuffer tokens;
+            BENCHMARK([&]() { tokens = lexer.tokenizeParallel(*pool); }, "Lexing");
 
-    CodeGenerator codegen;
-    BENCHMARK([&]() { codegen.generate(*ast); }, "Generating Code");
+            Parser parser(tokens);
+            BENCHMARK([&]() { ast = parser.parseProgram(*pool); }, "Parsing");
+        } else {
+            // The parser pulls tokens from the lexer as it goes, so both run together
+            Parser parser(lexer);
+            BENCHMARK([&]() { ast = parser.parseProgram(); }, "Lexing + Parsing");
+        }
+
+        if (options.cache) cache.store(source, *ast);
+    }
 
-    printPrettyTree(ast.get());
+    bool ok = emit(*ast, options, pool);
 
-    std::cout << "Exported to output.html\n";
+    // Nothing in the tree owns memory outside the arena: skip walking it on the way out
+    ast.release();
+    return ok;
+}
+
+// -dev: only the top-level blocks that changed since the last run are lexed and parsed again
+void runIncremental(const char* path, const Options& options, IncrementalCompiler& compiler, ThreadPool* pool) {
+    // A typo mid-edit is reported and the last good tree kept until the next save
+    try {
+        // Owned copy: the editor may rewrite the file under a mapping while we watch it
+        std::string source = readFile(path);
+        BENCHMARK([&]() { compiler.update(std::move(source), pool); }, "Lexing + Parsing");
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return;
+    }
+    std::cout << "Re-parsed " << compiler.stats().reparsed << " of "
+              << compiler.stats().blocks << " top-level blocks\n";
+
+    // The tree lives in the compiler's block arenas; this run's back end scratch goes here
+    Arena arena;
+    Arena::Scope scope(arena);
+    emit(compiler.tree(), options, pool);
+}
+
+// All of text as a number from min to max, or nothing
+std::optional<unsigned> parseNumber(std::string_view text, unsigned min, unsigned max) {
+    unsigned value = 0;
+    const char* end = text.data() + text.size();
+    auto [stop, error] = std::from_chars(text.data(), end, value);
+    if (text.empty() || error != std::errc() || stop != end || value < min || value > max) return std::nullopt;
+    return value;
 }
 
 int main(int argc, char const *argv[]) {
     if (argc < 2) return 1;
 
     const char* path = argv[1];
-    run(path);
-
-    if (argc > 2 && std::string(argv[2]) == "-dev") {
-        auto lastWrite = fs::last_write_time(path);
-        while (true) {
-            auto currentWrite = fs::last_write_time(path);
-            if (currentWrite != lastWrite) {
-                lastWrite = currentWrite;
-                run(path);
+
+    Options options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-dev") {
+            options.dev = true;
+        } else if (arg == "-no-cache") {
+            options.cache = false;
+        } else if (arg == "-external-css") {
+            options.externalCss = true;
+        } else if (arg == "-out-dir" && i + 1 < argc) {
+            options.outDir = argv[++i];
+        } else if (arg == "-emit-cpp" && i + 1 < argc) {
+            options.emitCpp = argv[++i];
+        } else if (arg == "-minify") {
+            options.minify = true;
+        } else if (arg.rfind("-precompress", 0) == 0 && (arg.size() == 12 || arg[12] == '=')) {
+            // -precompress = default level, -precompress=N = level N (1-11)
+            std::optional<unsigned> level =
+                arg.size() > 12 ? parseNumber(arg.substr(13), 1, 11) : CompressedCopies::DEFAULT_LEVEL;
+            if (!level) {
+                std::cerr << "Invalid compression level: " << arg << " (use -precompress or -precompress=N, N from 1 to 11)" << std::endl;
+                return 1;
+            }
+            options.precompress = static_cast<int>(*level);
+            if (CompressedCopies::formats().empty()) {
+                std::cerr << "Built without zlib or Brotli, ignoring " << arg << std::endl;
+                options.precompress = 0;
+            }
+        } else if (arg.rfind("-j", 0) == 0) {
+            // -j = all cores, -jN = N threads
+            std::optional<unsigned> jobs = arg.size() > 2 ? parseNumber(arg.substr(2), 0, 1024) : 0u;
+            if (!jobs) {
+                std::cerr << "Invalid thread count: " << arg << " (use -j or -jN, N up to 1024)" << std::endl;
+                return 1;
             }
-            std::this_thread::sleep_for(250ms);
+            options.jobs = *jobs;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // -j: front end runs on a worker pool
+    std::unique_ptr<ThreadPool> pool;
+    if (options.jobs != 1) pool = std::make_unique<ThreadPool>(options.jobs);
+
+    if (!options.dev) {
+        try {
+            return run(path, options, pool.get()) ? 0 : 1;
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    IncrementalCompiler compiler;
+    runIncremental(path, options, compiler, pool.get());
+
+    // Editors that save by replacing the file leave it missing for a moment
+    std::error_code missing;
+    auto lastWrite = fs::last_write_time(path, missing);
+    while (true) {
+        auto currentWrite = fs::last_write_time(path, missing);
+        if (!missing && currentWrite != lastWrite) {
+            lastWrite = currentWrite;
+            runIncremental(path, options, compiler, pool.get());
         }
+        std::this_thread::sleep_for(250ms);
     }
 }
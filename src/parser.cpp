@@ -1,4 +1,7 @@
 #include "parser.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <exception>
 #include <iostream>
 #include <stdexcept>
 
@@ -8,58 +11,72 @@ static void printIndent(int indent) {
     }
 }
 
-static void printTree(const ASTNode* node, const std::string& prefix = "", bool isLast = true) {
-    if (!node) return;
-    
-    std::cout << prefix;
-    std::cout << (isLast ? "`--> " : "|-> ");
-    
-    if (auto* root = dynamic_cast<const RootNode*>(node)) {
-        std::cout << "[Program]" << std::endl;
-        for (size_t i = 0; i < root->statements.size(); i++) {
-            printTree(root->statements[i].get(), 
-                     prefix + (isLast ? "    " : "|   "),
-                     i == root->statements.size() - 1);
-        }
-    }
-    else if (auto* title = dynamic_cast<const TitleStmtNode*>(node)) {
-        std::cout << "@title \"" << title->title << "\"" << std::endl;
-    }
-    else if (auto* screen = dynamic_cast<const ScreenStmtNode*>(node)) {
-        std::cout << "@screen " << screen->name << std::endl;
-        for (size_t i = 0; i < screen->body.size(); i++) {
-            printTree(screen->body[i].get(),
-                     prefix + (isLast ? "    " : "|   "),
-                     i == screen->body.size() - 1);
-        }
-    }
-    else if (auto* text = dynamic_cast<const TextStmtNode*>(node)) {
-        std::cout << "@text \"" << text->text << "\"" << std::endl;
-    }
-    else if (auto* save = dynamic_cast<const SaveStmtNode*>(node)) {
-        std::cout << "@save " << save->name << std::endl;
-        for (size_t i = 0; i < save->body.size(); i++) {
-            printTree(save->body[i].get(),
-                     prefix + (isLast ? "    " : "|   "),
-                     i == save->body.size() - 1);
-        }
-    }
-    else if (auto* load = dynamic_cast<const LoadStmtNode*>(node)) {
-        std::cout << "@load " << load->name << std::endl;
-        for (size_t i = 0; i < load->parameters.size(); i++) {
-            printTree(load->parameters[i].get(),
-                     prefix + (isLast ? "    " : "|   "),
-                     i == load->parameters.size() - 1);
-        }
-    } else if (auto* generic = dynamic_cast<const GenericAtStmtNode*>(node)) {
-        std::cout << "@" << generic->name << " ";
-        for (const auto& [k, v] : generic->htmlData) {
-            std::cout << k << "=" << v << " ";
-        }
-        std::cout << std::endl;
-    }
-    else if (auto* param = dynamic_cast<const ParameterNode*>(node)) {
-        std::cout << param->name << ": " << param->value << std::endl;
+static void printTree(const ASTNode* root) {
+    // Lines still to print, the next one on top. Kept on the heap instead of
+    // recursing, so any depth is fine.
+    struct Line {
+        const ASTNode* node;
+        std::string prefix;
+        bool isLast;
+    };
+    std::vector<Line> pending{{root, "", true}};
+
+    while (!pending.empty()) {
+        Line line = std::move(pending.back());
+        pending.pop_back();
+        const ASTNode* node = line.node;
+        if (!node) continue;
+
+        std::cout << line.prefix;
+        std::cout << (line.isLast ? "`--> " : "|-> ");
+
+        const std::string childPrefix = line.prefix + (line.isLast ? "    " : "|   ");
+        auto printChildren = [&](const auto& list) {
+            for (size_t i = list.size(); i-- > 0;) {
+                pending.push_back({list[i].get(), childPrefix, i == list.size() - 1});
+            }
+        };
+
+        visitNode(*node, Overloaded{
+            [&](const RootNode& root) {
+                std::cout << "[Program]" << std::endl;
+                printChildren(root.statements);
+            },
+            [&](const TitleStmtNode& title) {
+                std::cout << "@title \"" << title.title << "\"" << std::endl;
+            },
+            [&](const ScreenStmtNode& screen) {
+                std::cout << "@screen " << symbolName(screen.name) << std::endl;
+                printChildren(screen.body);
+            },
+            [&](const TextStmtNode& text) {
+                std::cout << "@text \"" << text.text << "\"" << std::endl;
+            },
+            [&](const SaveStmtNode& save) {
+                std::cout << "@save " << symbolName(save.name) << std::endl;
+                printChildren(save.body);
+            },
+            [&](const LoadStmtNode& load) {
+                std::cout << "@load " << symbolName(load.name) << std::endl;
+                printChildren(load.parameters);
+            },
+            [&](const GenericAtStmtNode& generic) {
+                std::cout << "@" << symbolName(generic.name) << " ";
+                for (const auto& [k, v] : generic.htmlData) {
+                    std::cout << symbolName(k) << "=" << v << " ";
+                }
+                std::cout << std::endl;
+            },
+            [&](const ParameterNode& param) {
+                std::cout << symbolName(param.name) << ": " << param.value << std::endl;
+            },
+            [](const LayoutStmtNode&) {
+                // Not shown in the tree view
+            },
+            [&](const ConstStmtNode& constant) {
+                std::cout << "@const " << symbolName(constant.name) << " = " << constant.value << std::endl;
+            },
+        });
     }
 }
 
@@ -69,7 +86,7 @@ void printPrettyTree(const RootNode* root) {
     std::cout << "          AST Tree View" << std::endl;
     std::cout << "========================================" << std::endl;
     std::cout << "\n";
-    printTree(root, "", true);
+    printTree(root);
     std::cout << "\n";
 }
 
@@ -88,7 +105,7 @@ void TitleStmtNode::print(int indent) const {
 
 void ScreenStmtNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "ScreenStmt: " << name << std::endl;
+    std::cout << "ScreenStmt: " << symbolName(name) << std::endl;
     for (const auto& stmt : body) {
         stmt->print(indent + 1);
     }
@@ -101,12 +118,12 @@ void TextStmtNode::print(int indent) const {
 
 void ParameterNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "Parameter: " << name << " = " << value << std::endl;
+    std::cout << "Parameter: " << symbolName(name) << " = " << value << std::endl;
 }
 
 void SaveStmtNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "SaveStmt: " << name << std::endl;
+    std::cout << "SaveStmt: " << symbolName(name) << std::endl;
     for (const auto& stmt : body) {
         stmt->print(indent + 1);
     }
@@ -114,7 +131,7 @@ void SaveStmtNode::print(int indent) const {
 
 void LoadStmtNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "LoadStmt: " << name << std::endl;
+    std::cout << "LoadStmt: " << symbolName(name) << std::endl;
     for (const auto& param : parameters) {
         param->print(indent + 1);
     }
@@ -122,9 +139,9 @@ void LoadStmtNode::print(int indent) const {
 
 void GenericAtStmtNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "GenericAtStmt: " << name << " ";
+    std::cout << "GenericAtStmt: " << symbolName(name) << " ";
     for (const auto& [k, v] : htmlData) {
-        std::cout << k << "=" << v << " ";
+        std::cout << symbolName(k) << "=" << v << " ";
     }
     std::cout << std::endl;
     for (const auto& stmt : body) {
@@ -135,54 +152,156 @@ void GenericAtStmtNode::print(int indent) const {
 
 void LayoutStmtNode::print(int indent) const {
     printIndent(indent);
-    std::cout << "LayoutStmt: " << layout << std::endl;
+    std::cout << "LayoutStmt: " << symbolName(layout) << std::endl;
     for (const auto& stmt : body) {
         stmt->print(indent + 1);
     }
 }
 
+void ConstStmtNode::print(int indent) const {
+    printIndent(indent);
+    std::cout << "ConstStmt: " << symbolName(name) << " = " << value << std::endl;
+}
+
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+Parser::Parser(const TokenBuffer& tokens, size_t start) : tokens(tokens, start) {}
 
-Token Parser::peek(int offset) const {
-    if (pos + offset < tokens.size()) {
-        return tokens[pos + offset];
-    }
-    return tokens.back();
+Parser::Parser(Lexer& lexer) : tokens(lexer) {}
+
+TokenType Parser::peek(int offset) {
+    return tokens.type(offset);
+}
+
+size_t Parser::currentLine() {
+    return tokens.line();
 }
 
 Token Parser::consume() {
-    if (pos < tokens.size()) {
-        return tokens[pos++];
-    }
-    return tokens.back();
+    return tokens.consume();
 }
 
 void Parser::skipNewlines() {
-    while (peek().type == TokenType::NEWLINE) {
+    while (peek() == TokenType::NEWLINE) {
         consume();
     }
 }
 
-std::unique_ptr<RootNode> Parser::parseProgram() {
-    auto program = std::make_unique<RootNode>();
-    
+void Parser::parseStatements(RootNode& program) {
     skipNewlines();
     
-    while (peek().type != TokenType::END_OF_FILE) {
+    while (peek() != TokenType::END_OF_FILE) {
         auto stmt = parseStatement(0);
         if (stmt) {
-            program->statements.push_back(std::move(stmt));
+            program.statements.push_back(std::move(stmt));
         }
         skipNewlines();
     }
-    
+}
+
+std::unique_ptr<RootNode> Parser::parseProgram() {
+    auto program = std::make_unique<RootNode>();
+    parseStatements(*program);
+    return program;
+}
+
+std::unique_ptr<RootNode> Parser::parseProgram(ThreadPool& pool) {
+    static constexpr size_t MIN_CHUNK_TOKENS = 16 * 1024;
+
+    const TokenBuffer* buffer = tokens.buffer();
+    if (!buffer || pool.size() < 2) return parseProgram();
+
+    auto program = std::make_unique<RootNode>();
+    skipNewlines();
+
+    // Block starts: the first token of every line that begins in column 0, plus
+    // END_OF_FILE as the end of the last block
+    const size_t first = tokens.position();
+    const size_t eof = buffer->size() - 1;
+    std::vector<size_t> starts;
+    for (size_t i = first; i < eof; i++) {
+        TokenType type = buffer->type(i);
+        if (type != TokenType::NEWLINE && type != TokenType::INDENT &&
+            (i == first || buffer->type(i - 1) == TokenType::NEWLINE)) {
+            starts.push_back(i);
+        }
+    }
+    starts.push_back(eof);
+
+    // Consecutive blocks are grouped into chunks of a worthwhile size
+    struct Chunk {
+        size_t firstBlock;
+        size_t endBlock;
+        Arena* arena;
+        std::vector<std::unique_ptr<ASTNode>> nodes; // one per block parsed
+        std::vector<size_t> ends;                    // where each of them stopped
+        std::exception_ptr error;                    // from the block after the last node
+    };
+
+    const size_t blocks = starts.size() - 1;
+    const size_t minTokens = std::max(MIN_CHUNK_TOKENS, (eof - first) / (pool.size() * 4));
+    std::vector<Chunk> chunks;
+    for (size_t b = 0; b < blocks;) {
+        size_t end = b + 1;
+        while (end < blocks && starts[end] - starts[b] < minTokens) end++;
+        chunks.push_back(Chunk{b, end, &Arena::current().child(), {}, {}, nullptr});
+        b = end;
+    }
+
+    if (chunks.size() < 2) {
+        parseStatements(*program);
+        return program;
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t c) {
+        Chunk& chunk = chunks[c];
+        Arena::Scope scope(*chunk.arena);
+
+        for (size_t b = chunk.firstBlock; b < chunk.endBlock; b++) {
+            Parser block(*buffer, starts[b]);
+            try {
+                chunk.nodes.push_back(block.parseStatement(0));
+                block.skipNewlines();
+            } catch (...) {
+                chunk.error = std::current_exception();
+                return;
+            }
+
+            chunk.ends.push_back(block.tokens.position());
+            // Stopped somewhere else than the next block: the rest of the chunk
+            // would not be parsed from where a sequential parse would be
+            if (chunk.ends.back() != starts[b + 1]) return;
+        }
+    });
+
+    // Take the blocks in source order. A block that stopped early or late is where
+    // the token stream stops lining up with the blocks: parse from there sequentially
+    for (Chunk& chunk : chunks) {
+        for (size_t i = 0; i < chunk.nodes.size(); i++) {
+            const size_t b = chunk.firstBlock + i;
+            if (chunk.ends[i] != starts[b + 1]) {
+                tokens.seek(starts[b]);
+                parseStatements(*program);
+                return program;
+            }
+            if (chunk.nodes[i]) program->statements.push_back(std::move(chunk.nodes[i]));
+        }
+        if (chunk.error) std::rethrow_exception(chunk.error);
+    }
+
+    tokens.seek(eof);
     return program;
 }
 
 std::unique_ptr<ASTNode> Parser::parseStatement(int currentIndent) {
+    bool hasBlock = false;
+    auto stmt = parseStatementHeader(currentIndent, hasBlock);
+    if (hasBlock) parseBlock(currentIndent, *stmt);
+    return stmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseStatementHeader(int currentIndent, bool& hasBlock) {
     int indent = 0;
-    while (peek(indent).type == TokenType::INDENT) {
+    while (peek(indent) == TokenType::INDENT) {
         indent++;
     }
     
@@ -194,118 +313,155 @@ std::unique_ptr<ASTNode> Parser::parseStatement(int currentIndent) {
         consume();
     }
     
-    switch (peek().type) {
+    switch (peek()) {
         case TokenType::AT_TITLE:
             return parseTitleStmt();
         case TokenType::AT_SCREEN:
-            return parseScreenStmt(currentIndent);
+            hasBlock = true;
+            return parseScreenStmt();
         case TokenType::AT_TEXT:
             return parseTextStmt();
         case TokenType::AT_SAVE:
-            return parseSaveStmt(currentIndent);
+            hasBlock = true;
+            return parseSaveStmt();
         case TokenType::AT_LOAD:
             return parseLoadStmt(currentIndent);
+        case TokenType::AT_CONSTANT:
+            return parseConstStmt(currentIndent);
         case TokenType::AT_IDENTIFIER:
-            return parseGenericAtStmt(currentIndent);
+            return parseGenericAtStmt(hasBlock);
         case TokenType::AT_ROW:
         case TokenType::AT_STACK:
         case TokenType::AT_LEFT:
         case TokenType::AT_RIGHT:
         case TokenType::AT_CENTER:
-            return parseLayoutStmt(currentIndent, peek().type);
+            hasBlock = true;
+            return parseLayoutStmt(peek());
         default:
             return nullptr;
     }
 }
 
-std::vector<std::unique_ptr<ASTNode>> Parser::parseBlock(int parentIndent) {
-    std::vector<std::unique_ptr<ASTNode>> statements;
-    int blockIndent = parentIndent + 1;
-    
-    skipNewlines();
-    
-    while (peek().type != TokenType::END_OF_FILE) {
+void Parser::parseBlock(int parentIndent, ASTNode& owner) {
+    // Nested blocks go on this stack instead of recursing, so nesting depth is
+    // bounded by memory rather than by the call stack
+    struct OpenBlock {
+        ASTNode* owner;
+        int indent;
+    };
+    std::vector<OpenBlock> open{{&owner, parentIndent + 1}};
 
-        // Count indentation
-        int indent = 0;
-        int offset = 0;
-        while (peek(offset).type == TokenType::INDENT) {
-            indent++;
-            offset++;
-        }
+    skipNewlines();
 
-        // Case 1: blank line → skip it
-        if (peek(offset).type == TokenType::NEWLINE) {
-            // consume the entire blank line
-            for (int i = 0; i < offset; i++)
+    while (!open.empty()) {
+        const OpenBlock block = open.back();
+        bool nested = false;
+
+        while (peek() != TokenType::END_OF_FILE) {
+
+            // Count indentation
+            int indent = 0;
+            int offset = 0;
+            while (peek(offset) == TokenType::INDENT) {
+                indent++;
+                offset++;
+            }
+
+            // Case 1: blank line → skip it
+            if (peek(offset) == TokenType::NEWLINE) {
+                // consume the entire blank line
+                for (int i = 0; i < offset; i++)
+                    consume();
+                // consume NEWLINE
                 consume();
-            // consume NEWLINE
-            consume();
-            continue;        // do not treat as a statement
+                continue;        // do not treat as a statement
+            }
+
+            // Case 2: indentation mismatch
+            if (indent < block.indent)
+                break;
+
+            if (indent > block.indent)
+                throw std::runtime_error("Unexpected indentation at line " +
+                                        std::to_string(currentLine()));
+
+            // Parse normally
+            bool hasBlock = false;
+            auto stmt = parseStatementHeader(block.indent, hasBlock);
+            if (!stmt) break;
+
+            ASTNode* node = stmt.get();
+            block.owner->children()->push_back(std::move(stmt));
+            skipNewlines();
+
+            // Its own block comes first, this one resumes when that is done
+            if (hasBlock) {
+                open.push_back({node, block.indent + 1});
+                nested = true;
+                break;
+            }
         }
 
-        // Case 2: indentation mismatch
-        if (indent < blockIndent)
-            break;
+        if (nested) continue;
 
-        if (indent > blockIndent)
-            throw std::runtime_error("Unexpected indentation at line " +
-                                    std::to_string(peek().line));
-
-        // Parse normally
-        auto stmt = parseStatement(blockIndent);
-        if (stmt) statements.push_back(std::move(stmt));
-        else break;
+        open.pop_back();
+        endBlock(*block.owner);
+        if (!open.empty()) skipNewlines();
+    }
+}
 
-        skipNewlines();
+void Parser::endBlock(ASTNode& owner) {
+    // TODO: Fix this bug right here
+    if (owner.kind == NodeKind::GenericAt) {
+        if (peek() != TokenType::NEWLINE) {
+            throw std::runtime_error("Expected newline after generic at statement at line " +
+                std::to_string(currentLine()));
+        }
+        consume(); // consume newline
     }
-    
-    return statements;
 }
 
 std::unique_ptr<TitleStmtNode> Parser::parseTitleStmt() {
     consume(); // consume @title
     
-    if (peek().type != TokenType::STRING) {
+    if (peek() != TokenType::STRING) {
         throw std::runtime_error("Expected string after @title at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     
-    std::string title = consume().value.value();
+    std::string_view title = consume().text();
     
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after title at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     consume(); // consume newline
     
     return std::make_unique<TitleStmtNode>(title);
 }
 
-std::unique_ptr<ScreenStmtNode> Parser::parseScreenStmt(int currentIndent) {
+std::unique_ptr<ScreenStmtNode> Parser::parseScreenStmt() {
     consume(); // consume @screen
     
-    if (peek().type != TokenType::IDENTIFIER) {
+    if (peek() != TokenType::IDENTIFIER) {
         throw std::runtime_error("Expected identifier after @screen at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     
-    std::string screenName = consume().value.value();
+    Symbol screenName = consume().symbol;
     auto screen = std::make_unique<ScreenStmtNode>(screenName);
 
-    if (peek().type != TokenType::COLON) {
+    if (peek() != TokenType::COLON) {
         throw std::runtime_error("Expected colon after screen name at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     consume(); // consume colon
     
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after colon at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
-    consume(); // consume newline before parsing block
-    
-    screen->body = parseBlock(currentIndent);
+    consume(); // consume newline, the caller parses the block
     
     return screen;
 }
@@ -313,46 +469,44 @@ std::unique_ptr<ScreenStmtNode> Parser::parseScreenStmt(int currentIndent) {
 std::unique_ptr<TextStmtNode> Parser::parseTextStmt() {
     consume(); // consume @text
     
-    if (peek().type != TokenType::STRING) {
+    if (peek() != TokenType::STRING) {
         throw std::runtime_error("Expected string after @text at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     
-    std::string text = consume().value.value();
+    std::string_view text = consume().text();
     
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after text string at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     consume(); // consume newline
     
     return std::make_unique<TextStmtNode>(text);
 }
 
-std::unique_ptr<SaveStmtNode> Parser::parseSaveStmt(int currentIndent) {
+std::unique_ptr<SaveStmtNode> Parser::parseSaveStmt() {
     consume(); // consume @save
     
-    if (peek().type != TokenType::IDENTIFIER) {
+    if (peek() != TokenType::IDENTIFIER) {
         throw std::runtime_error("Expected identifier after @save at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     
-    std::string componentName = consume().value.value();
+    Symbol componentName = consume().symbol;
     auto component = std::make_unique<SaveStmtNode>(componentName);
 
-    if (peek().type != TokenType::COLON) {
+    if (peek() != TokenType::COLON) {
         throw std::runtime_error("Expected colon after component name at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     consume(); // consume colon
     
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after colon at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
-    consume(); // consume newline
-    
-    component->body = parseBlock(currentIndent);
+    consume(); // consume newline, the caller parses the block
     
     return component;
 }
@@ -360,90 +514,87 @@ std::unique_ptr<SaveStmtNode> Parser::parseSaveStmt(int currentIndent) {
 std::unique_ptr<LoadStmtNode> Parser::parseLoadStmt(int currentIndent) {
     consume(); // consume @load
     
-    if (peek().type != TokenType::IDENTIFIER) {
+    if (peek() != TokenType::IDENTIFIER) {
         throw std::runtime_error("Expected identifier after @load at line " + 
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     
-    std::string componentName = consume().value.value();
+    Symbol componentName = consume().symbol;
     auto component = std::make_unique<LoadStmtNode>(componentName);
 
-    if (peek().type == TokenType::WITH) {
+    if (peek() == TokenType::WITH) {
         consume(); // consume WITH
 
-        if (peek().type != TokenType::COLON) {
+        if (peek() != TokenType::COLON) {
             throw std::runtime_error("Expected colon after 'with' at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
         consume(); // consume colon
         
-        if (peek().type != TokenType::NEWLINE) {
+        if (peek() != TokenType::NEWLINE) {
             throw std::runtime_error("Expected newline after colon at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
         consume(); // consume newline
 
         component->parameters = std::move(parseParameters(currentIndent));
 
     } else {
-        if (peek().type != TokenType::NEWLINE) {
+        if (peek() != TokenType::NEWLINE) {
             throw std::runtime_error("Expected newline after load statement at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
-        component->parameters = std::vector<std::unique_ptr<ParameterNode>>();
         consume(); // consume newline
     }
 
     return component;
 }
 
-std::unique_ptr<GenericAtStmtNode> Parser::parseGenericAtStmt(int currentIndent) {
-    std::string genericName = consume().value.value(); // consume and return @<value>
+std::unique_ptr<GenericAtStmtNode> Parser::parseGenericAtStmt(bool& hasBlock) {
+    Symbol genericName = consume().symbol; // consume and return @<value>
 
-    std::string headerValue = peek().type == TokenType::STRING ? consume().value.value() : "";
-    std::vector<std::pair<std::string, std::string>> htmlParams;
+    std::string_view headerValue = peek() == TokenType::STRING ? consume().text() : std::string_view();
+    HtmlAttributes htmlParams(Arena::current().resource());
 
-    while (peek().type == TokenType::IDENTIFIER
-           && peek(1).type == TokenType::EQUAL
-           && peek(2).type == TokenType::STRING) {
-            std::string htmlParam = consume().value.value();
+    while (peek() == TokenType::IDENTIFIER
+           && peek(1) == TokenType::EQUAL
+           && peek(2) == TokenType::STRING) {
+            Symbol htmlParam = consume().symbol;
             consume(); // consume =
-            std::string htmlValue = consume().value.value();
+            std::string_view htmlValue = consume().text();
             htmlParams.push_back(std::make_pair(htmlParam, htmlValue));
     }
 
-    std::vector<std::unique_ptr<ASTNode>> body;
-    if (peek().type == TokenType::COLON) {
+    auto generic = std::make_unique<GenericAtStmtNode>(genericName, headerValue);
+    generic->htmlData = std::move(htmlParams);
+
+    // With a block, the newline is expected after it (see endBlock)
+    if (peek() == TokenType::COLON) {
         consume(); // consume colon
-        body = parseBlock(currentIndent);
-    } else {
-        body = std::vector<std::unique_ptr<ASTNode>>();
+        hasBlock = true;
+        return generic;
     }
 
-    // TODO: Fix this bug right here
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after generic at statement at line " + 
-            std::to_string(peek().line));
+            std::to_string(currentLine()));
     }
     consume(); // consume newline
     
-    auto generic = std::make_unique<GenericAtStmtNode>(genericName, headerValue);
-    generic->htmlData = std::move(htmlParams);
-    generic->body = std::move(body);
     return generic;
 
 }
 
-std::vector<std::unique_ptr<ParameterNode>> Parser::parseParameters(int parentIndent) {
-    std::vector<std::unique_ptr<ParameterNode>> parameters;
+std::pmr::vector<std::unique_ptr<ParameterNode>> Parser::parseParameters(int parentIndent) {
+    std::pmr::vector<std::unique_ptr<ParameterNode>> parameters(Arena::current().resource());
     int blockIndent = parentIndent + 1;
     
     skipNewlines();
     
-    while (peek().type != TokenType::END_OF_FILE) {
+    while (peek() != TokenType::END_OF_FILE) {
         int indent = 0;
         int offset = 0;
-        while (peek(offset).type == TokenType::INDENT) {
+        while (peek(offset) == TokenType::INDENT) {
             indent++;
             offset++;
         }
@@ -454,31 +605,31 @@ std::vector<std::unique_ptr<ParameterNode>> Parser::parseParameters(int parentIn
         
         if (indent > blockIndent) {
             throw std::runtime_error("Unexpected indentation at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
         
         for (int i = 0; i < indent; i++) {
             consume();
         }
         
-        if (peek().type != TokenType::IDENTIFIER) {
+        if (peek() != TokenType::IDENTIFIER) {
             break;
         }
         
-        std::string paramName = consume().value.value();
+        Symbol paramName = consume().symbol;
         
-        if (peek().type != TokenType::COLON) {
+        if (peek() != TokenType::COLON) {
             throw std::runtime_error("Expected colon after parameter name at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
         consume(); // consume colon
         
-        if (peek().type != TokenType::STRING && peek().type != TokenType::IDENTIFIER && peek().type != TokenType::NUMBER) {
+        if (peek() != TokenType::STRING && peek() != TokenType::IDENTIFIER && peek() != TokenType::NUMBER) {
             throw std::runtime_error("Expected value after colon at line " + 
-                                   std::to_string(peek().line));
+                                   std::to_string(currentLine()));
         }
         
-        std::string paramValue = consume().value.value();
+        std::string_view paramValue = consume().text();
         parameters.push_back(std::make_unique<ParameterNode>(paramName, paramValue));
         
         skipNewlines();
@@ -487,12 +638,12 @@ std::vector<std::unique_ptr<ParameterNode>> Parser::parseParameters(int parentIn
     return parameters;
 }
 
-std::unique_ptr<LayoutStmtNode> Parser::parseLayoutStmt(int currentIndent, TokenType type) {
-    std::string layout = "";
+std::unique_ptr<LayoutStmtNode> Parser::parseLayoutStmt(TokenType type) {
+    std::string_view layout;
 
-    if (peek().type != type) {
+    if (peek() != type) {
         throw std::runtime_error("Expected layout type at line " +
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
 
     switch (type) {
@@ -516,21 +667,54 @@ std::unique_ptr<LayoutStmtNode> Parser::parseLayoutStmt(int currentIndent, Token
     consume(); // consume layout type token
 
     auto layoutNode = std::make_unique<LayoutStmtNode>();
-    layoutNode->layout = layout;
+    layoutNode->layout = intern(layout);
 
-    if (peek().type != TokenType::COLON) {
+    if (peek() != TokenType::COLON) {
         throw std::runtime_error("Expected colon after layout type at line " +
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
     consume(); // consume colon
 
-    if (peek().type != TokenType::NEWLINE) {
+    if (peek() != TokenType::NEWLINE) {
         throw std::runtime_error("Expected newline after colon at line " +
-                               std::to_string(peek().line));
+                               std::to_string(currentLine()));
     }
-    consume(); // consume newline
-
-    layoutNode->body = parseBlock(currentIndent);
+    consume(); // consume newline, the caller parses the block
 
     return layoutNode;
 }
+
+std::unique_ptr<ConstStmtNode> Parser::parseConstStmt(int currentIndent) {
+    // Constants are file-wide, a nested one would look scoped when it isn't
+    if (currentIndent != 0) {
+        throw std::runtime_error("@const is only allowed at the top level at line " +
+                               std::to_string(currentLine()));
+    }
+    consume(); // consume @const
+
+    if (peek() != TokenType::IDENTIFIER) {
+        throw std::runtime_error("Expected identifier after @const at line " +
+                               std::to_string(currentLine()));
+    }
+    Symbol name = consume().symbol;
+
+    if (peek() != TokenType::EQUAL) {
+        throw std::runtime_error("Expected '=' after constant name at line " +
+                               std::to_string(currentLine()));
+    }
+    consume(); // consume =
+
+    if (peek() != TokenType::STRING && peek() != TokenType::IDENTIFIER && peek() != TokenType::NUMBER) {
+        throw std::runtime_error("Expected value after '=' at line " +
+                               std::to_string(currentLine()));
+    }
+    std::string_view value = consume().text();
+
+    if (peek() != TokenType::NEWLINE) {
+        throw std::runtime_error("Expected newline after constant value at line " +
+                               std::to_string(currentLine()));
+    }
+    consume(); // consume newline
+
+    return std::make_unique<ConstStmtNode>(name, value);
+}
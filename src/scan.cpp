@@ -0,0 +1,283 @@
+#include "scan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EAML_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace scan {
+
+// -------------------------------
+// Scalar kernels (reference + tails)
+// -------------------------------
+static inline bool isIdentChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char* stringStopScalar(const char* p, const char* end) {
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+static const char* lineEndScalar(const char* p, const char* end) {
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+static const char* identEndScalar(const char* p, const char* end) {
+    while (p < end && isIdentChar(static_cast<unsigned char>(*p))) p++;
+    return p;
+}
+
+static const char* structuralScalar(const char* p, const char* end) {
+    while (p < end && *p != '"' && *p != '#' && *p != '\n') p++;
+    return p;
+}
+
+static const char* htmlTextScalar(const char* p, const char* end) {
+    while (p < end && *p != '<' && *p != '>' && *p != '&') p++;
+    return p;
+}
+
+static const char* htmlAttributeScalar(const char* p, const char* end) {
+    while (p < end && *p != '<' && *p != '>' && *p != '&' && *p != '"' && *p != '\'') p++;
+    return p;
+}
+
+#ifdef EAML_SCAN_X86
+
+// -------------------------------
+// SSE2 kernels (16 bytes per step)
+// -------------------------------
+__attribute__((target("sse2")))
+static inline __m128i identMask128(__m128i v) {
+    // Unsigned "x <= bound" is min(x, bound) == x
+    const __m128i lower = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    const __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(lower, _mm_set1_epi8(25)), lower);
+    const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i isUnderscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(isAlpha, isDigit), isUnderscore);
+}
+
+__attribute__((target("sse2")))
+static const char* stringStopSSE2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return stringStopScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* lineEndSSE2(const char* p, const char* end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return lineEndScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* identEndSSE2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int mask = ~_mm_movemask_epi8(identMask128(v)) & 0xFFFF;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return identEndScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* structuralSSE2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, hash)),
+                                         _mm_cmpeq_epi8(v, newline));
+        const int mask = _mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return structuralScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* htmlTextSSE2(const char* p, const char* end) {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                                         _mm_cmpeq_epi8(v, amp));
+        const int mask = _mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return htmlTextScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* htmlAttributeSSE2(const char* p, const char* end) {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i apostrophe = _mm_set1_epi8('\'');
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i text = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                                          _mm_cmpeq_epi8(v, amp));
+        const __m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, apostrophe));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(text, quotes));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return htmlAttributeScalar(p, end);
+}
+
+// -------------------------------
+// AVX2 kernels (32 bytes per step)
+// -------------------------------
+__attribute__((target("avx2")))
+static inline __m256i identMask256(__m256i v) {
+    const __m256i lower = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    const __m256i isAlpha = _mm256_cmpeq_epi8(_mm256_min_epu8(lower, _mm256_set1_epi8(25)), lower);
+    const __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    const __m256i isUnderscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(isAlpha, isDigit), isUnderscore);
+}
+
+__attribute__((target("avx2")))
+static const char* stringStopAVX2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash))));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return stringStopSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* lineEndAVX2(const char* p, const char* end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return lineEndSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* identEndAVX2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(identMask256(v)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return identEndSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* structuralAVX2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i hash = _mm256_set1_epi8('#');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, hash)),
+                                            _mm256_cmpeq_epi8(v, newline));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return structuralSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* htmlTextAVX2(const char* p, const char* end) {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i amp = _mm256_set1_epi8('&');
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                            _mm256_cmpeq_epi8(v, amp));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return htmlTextSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* htmlAttributeAVX2(const char* p, const char* end) {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i apostrophe = _mm256_set1_epi8('\'');
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i text = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                             _mm256_cmpeq_epi8(v, amp));
+        const __m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, apostrophe));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(text, quotes)));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return htmlAttributeSSE2(p, end);
+}
+
+#endif // EAML_SCAN_X86
+
+static const Kernels SCALAR_KERNELS = { Isa::Scalar, stringStopScalar, lineEndScalar, identEndScalar, structuralScalar,
+                                        htmlTextScalar, htmlAttributeScalar };
+#ifdef EAML_SCAN_X86
+static const Kernels SSE2_KERNELS = { Isa::SSE2, stringStopSSE2, lineEndSSE2, identEndSSE2, structuralSSE2,
+                                      htmlTextSSE2, htmlAttributeSSE2 };
+static const Kernels AVX2_KERNELS = { Isa::AVX2, stringStopAVX2, lineEndAVX2, identEndAVX2, structuralAVX2,
+                                      htmlTextAVX2, htmlAttributeAVX2 };
+#endif
+
+Isa detectIsa() {
+#ifdef EAML_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#endif
+    return Isa::Scalar;
+}
+
+const Kernels& kernels(Isa isa) {
+#ifdef EAML_SCAN_X86
+    static const Isa supported = detectIsa();
+    if (isa == Isa::AVX2 && supported == Isa::AVX2) return AVX2_KERNELS;
+    if (isa != Isa::Scalar && supported != Isa::Scalar) return SSE2_KERNELS;
+#else
+    (void)isa;
+#endif
+    return SCALAR_KERNELS;
+}
+
+const Kernels& best() {
+    static const Kernels& chosen = kernels(detectIsa());
+    return chosen;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+}
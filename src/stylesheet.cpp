@@ -0,0 +1,249 @@
+#include "stylesheet.hpp"
+#include "hash.hpp"
+#include <cctype>
+#include <cstdio>
+
+void SelectorUsage::addClasses(std::string_view list) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t start = list.find_first_not_of(" \t\n\r\f", pos);
+        if (start == std::string_view::npos) break;
+        size_t end = list.find_first_of(" \t\n\r\f", start);
+        if (end == std::string_view::npos) end = list.size();
+        classes.insert(list.substr(start, end - start));
+        pos = end;
+    }
+}
+
+namespace {
+
+bool isSpace(char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; }
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+// Just past the comment or string that starts at i, or i itself if none does
+size_t skipAtom(std::string_view css, size_t i) {
+    if (css.compare(i, 2, "/*") == 0) {
+        size_t end = css.find("*/", i + 2);
+        return end == std::string_view::npos ? css.size() : end + 2;
+    }
+    if (css[i] == '"' || css[i] == '\'') {
+        for (size_t j = i + 1; j < css.size(); j++) {
+            if (css[j] == '\\') j++;
+            else if (css[j] == css[i]) return j + 1;
+        }
+        return css.size();
+    }
+    return i;
+}
+
+// Index of the first of stops outside comments, strings and parentheses, or css.size()
+size_t findTopLevel(std::string_view css, size_t i, std::string_view stops) {
+    int parens = 0;
+    while (i < css.size()) {
+        size_t skipped = skipAtom(css, i);
+        if (skipped != i) {
+            i = skipped;
+            continue;
+        }
+        char c = css[i];
+        if (c == '(') parens++;
+        else if (c == ')' && parens > 0) parens--;
+        else if (parens == 0 && stops.find(c) != std::string_view::npos) return i;
+        i++;
+    }
+    return css.size();
+}
+
+// Just past the '}' closing the block opened at css[open]
+size_t blockEnd(std::string_view css, size_t open) {
+    int depth = 0;
+    size_t i = open;
+    while (i < css.size()) {
+        size_t skipped = skipAtom(css, i);
+        if (skipped != i) {
+            i = skipped;
+            continue;
+        }
+        if (css[i] == '{') depth++;
+        else if (css[i] == '}' && --depth == 0) return i + 1;
+        i++;
+    }
+    return css.size();
+}
+
+bool isNameChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ||
+           static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Whether every class and id a single selector needs is on the page
+bool canMatch(std::string_view selector, const SelectorUsage& used) {
+    int parens = 0;
+    size_t i = 0;
+    while (i < selector.size()) {
+        size_t skipped = skipAtom(selector, i);
+        if (skipped != i) {
+            i = skipped;
+            continue;
+        }
+
+        char c = selector[i];
+        if (c == '(') {
+            parens++;
+        } else if (c == ')' && parens > 0) {
+            parens--;
+        } else if (c == '[') {
+            size_t close = findTopLevel(selector, i + 1, "]");
+            i = close;
+        } else if (c == '\\') {
+            i++; // an escaped character is never a '.' or '#'
+        } else if ((c == '.' || c == '#') && parens == 0) {
+            size_t end = i + 1;
+            while (end < selector.size() && isNameChar(selector[end])) end++;
+            std::string_view name = selector.substr(i + 1, end - i - 1);
+            bool escaped = end < selector.size() && selector[end] == '\\';
+            // Escaped names are left alone rather than decoded
+            if (!name.empty() && !escaped) {
+                const auto& names = c == '.' ? used.classes : used.ids;
+                if (!names.count(name)) return false;
+            }
+            i = end;
+            continue;
+        }
+        i++;
+    }
+    return true;
+}
+
+// At-rules whose block is a list of rules, pruned like the top level
+bool holdsRules(std::string_view prelude) {
+    for (std::string_view name : {"@media", "@supports", "@layer", "@container", "@document"}) {
+        if (prelude.compare(0, name.size(), name) == 0 &&
+            (prelude.size() == name.size() || !isNameChar(prelude[name.size()])))
+            return true;
+    }
+    return false;
+}
+
+// Rules go to out one after another, each starting with indent
+void pruneRules(std::string_view css, const SelectorUsage& used, std::string_view indent, std::string& out) {
+    size_t i = 0;
+    while (i < css.size()) {
+        if (isSpace(css[i])) {
+            i++;
+            continue;
+        }
+        size_t skipped = skipAtom(css, i);
+        if (skipped != i && css[i] == '/') {
+            i = skipped; // comments go
+            continue;
+        }
+
+        size_t start = i;
+        size_t stop = findTopLevel(css, i, "{;}");
+        if (stop == css.size() || css[stop] == '}') {
+            // Stray text (broken input): kept as it is
+            size_t end = stop == css.size() ? stop : stop + 1;
+            out.append(indent).append(trim(css.substr(start, end - start))).append("\n");
+            i = end;
+            continue;
+        }
+        if (css[stop] == ';') {
+            // A statement at-rule such as @import
+            out.append(indent).append(css.substr(start, stop + 1 - start)).append("\n\n");
+            i = stop + 1;
+            continue;
+        }
+
+        size_t end = blockEnd(css, stop);
+        std::string_view prelude = trim(css.substr(start, stop - start));
+        std::string_view block = css.substr(stop, end - stop);
+        i = end;
+
+        if (prelude.empty() || prelude.front() == '@') {
+            if (!holdsRules(prelude)) {
+                out.append(indent).append(css.substr(start, end - start)).append("\n\n");
+                continue;
+            }
+            std::string nested;
+            pruneRules(block.substr(1, block.size() > 1 ? block.size() - 2 : 0), used,
+                       std::string(indent) + "    ", nested);
+            if (nested.empty()) continue;
+            nested.pop_back(); // no blank line before the closing brace
+            out.append(indent).append(prelude).append(" {\n").append(nested).append(indent).append("}\n\n");
+            continue;
+        }
+
+        std::string kept;
+        bool all = true;
+        size_t from = 0;
+        while (from <= prelude.size()) {
+            size_t comma = findTopLevel(prelude, from, ",");
+            std::string_view selector = trim(prelude.substr(from, comma - from));
+            if (canMatch(selector, used)) {
+                if (!kept.empty()) kept.append(", ");
+                kept.append(selector);
+            } else {
+                all = false;
+            }
+            from = comma + 1;
+        }
+        if (kept.empty()) continue;
+
+        out.append(indent);
+        if (all) out.append(css.substr(start, end - start));
+        else out.append(kept).append(" ").append(block);
+        out.append("\n\n");
+    }
+}
+
+} // namespace
+
+std::string pruneStylesheet(std::string_view css, const SelectorUsage& used) {
+    std::string out;
+    out.reserve(css.size());
+    pruneRules(css, used, "", out);
+    return out;
+}
+
+std::string minifyStylesheet(std::string_view css) {
+    // Punctuation a space next to never means anything; after ':' it doesn't either,
+    // but before one it may ("a :hover" is not "a:hover")
+    auto tight = [](char c) { return c == '{' || c == '}' || c == ';' || c == ',' || c == '>'; };
+
+    std::string out;
+    out.reserve(css.size());
+    size_t i = 0;
+    while (i < css.size()) {
+        size_t skipped = skipAtom(css, i);
+        if (skipped != i) {
+            if (css[i] != '/') out.append(css.substr(i, skipped - i)); // comments go
+            i = skipped;
+            continue;
+        }
+
+        char c = css[i];
+        if (isSpace(c)) {
+            while (i < css.size() && isSpace(css[i])) i++;
+            if (!out.empty() && i < css.size() && !tight(out.back()) && out.back() != ':' && !tight(css[i]))
+                out.push_back(' ');
+            continue;
+        }
+        if (c == '}' && !out.empty() && out.back() == ';') out.pop_back();
+        if (tight(c) && !out.empty() && out.back() == ' ') out.pop_back();
+        out.push_back(c);
+        i++;
+    }
+    return out;
+}
+
+std::string hashedStylesheetName(std::string_view css) {
+    char hex[17];
+    std::snprintf(hex, sizeof hex, "%016llx", static_cast<unsigned long long>(ContentHash::of(css)));
+    return "style." + std::string(hex, 16) + ".css";
+}
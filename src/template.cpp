@@ -0,0 +1,122 @@
+#include "template.hpp"
+#include <cstring>
+
+uint32_t SlotTable::slot(Symbol name) {
+    auto [it, added] = index.emplace(name, static_cast<uint32_t>(names.size()));
+    if (added) names.push_back(name);
+    return it->second;
+}
+
+uint32_t SlotTable::find(Symbol name) const {
+    auto it = index.find(name);
+    return it == index.end() ? NONE : it->second;
+}
+
+TextTemplate::TextTemplate(std::string_view text, SlotTable& slots)
+    : text(text), segments(Arena::current().resource()) {
+    size_t literal = 0;
+    size_t pos = 0;
+    while ((pos = text.find('{', pos)) != std::string_view::npos) {
+        size_t close = text.find_first_of("{}", pos + 1);
+        if (close == std::string_view::npos) break;
+        if (text[close] == '{') {
+            // "{{name}": the first brace is literal, the second may still open one
+            pos = close;
+            continue;
+        }
+
+        if (pos > literal) segments.push_back({text.substr(literal, pos - literal), SlotTable::NONE});
+        uint32_t slot = slots.slot(intern(text.substr(pos + 1, close - pos - 1)));
+        segments.push_back({text.substr(pos, close + 1 - pos), slot});
+        slotted = true;
+        literal = pos = close + 1;
+    }
+    if (literal < text.size()) segments.push_back({text.substr(literal), SlotTable::NONE});
+}
+
+std::string_view TextTemplate::render(const SlotValues& values, Arena& arena) const {
+    if (!slotted) return text;
+
+    auto bound = [&](const Segment& segment) -> const std::string_view* {
+        return segment.slot < values.size() ? values[segment.slot] : nullptr;
+    };
+
+    size_t length = 0;
+    bool any = false;
+    for (const auto& segment : segments) {
+        const std::string_view* value = bound(segment);
+        any |= value != nullptr;
+        length += value ? value->size() : segment.text.size();
+    }
+    if (!any) return text;
+
+    char* out = static_cast<char*>(arena.allocate(length, 1));
+    char* p = out;
+    for (const auto& segment : segments) {
+        const std::string_view* value = bound(segment);
+        std::string_view part = value ? *value : segment.text;
+        if (!part.empty()) std::memcpy(p, part.data(), part.size());
+        p += part.size();
+    }
+    return std::string_view(out, length);
+}
+
+void TextTemplate::render(OutputSink& out, const Scope* scope, Escape context) const {
+    if (!slotted) {
+        out.write(text, context);
+        return;
+    }
+
+    // Values with placeholders of their own are rendered off a stack, not recursively
+    struct Pending {
+        const TextTemplate* source;
+        size_t next;
+        const Scope* scope;
+    };
+    std::vector<Pending> pending;
+    Pending current{this, 0, scope};
+
+    for (;;) {
+        if (current.next == current.source->segments.size()) {
+            if (pending.empty()) return;
+            current = pending.back();
+            pending.pop_back();
+            continue;
+        }
+
+        const Segment& segment = current.source->segments[current.next++];
+        if (segment.slot == SlotTable::NONE) {
+            out.write(segment.text, context);
+            continue;
+        }
+
+        const Scope* owner = current.scope;
+        const TextTemplate* value = nullptr;
+        for (; owner; owner = owner->parent)
+            if ((value = owner->find(segment.slot))) break;
+
+        if (!value) {
+            out.write(segment.text, context);
+        } else if (!value->slotted) {
+            out.write(value->text, context);
+        } else {
+            pending.push_back(current);
+            current = {value, 0, owner->parent};
+        }
+    }
+}
+
+void TextTemplate::slotsInto(std::vector<uint32_t>& out) const {
+    for (const auto& segment : segments)
+        if (segment.slot != SlotTable::NONE) out.push_back(segment.slot);
+}
+
+bool renderSlot(uint32_t slot, OutputSink& out, const Scope* scope) {
+    for (; scope; scope = scope->parent) {
+        if (const TextTemplate* value = scope->find(slot)) {
+            value->render(out, scope->parent);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,103 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+static thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+
+    // Nested loop or nothing to share: just run it here
+    if (insidePool || workers.empty() || count == 1) {
+        std::exception_ptr error;
+        for (size_t i = 0; i < count; i++) {
+            try {
+                fn(i);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+
+    job = Job();
+    job.fn = &fn;
+    job.count = count;
+    generation++;
+    wake.notify_all();
+
+    insidePool = true;
+    runItems(lock);
+    insidePool = false;
+
+    done.wait(lock, [this]() { return job.next >= job.count && job.active == 0; });
+
+    std::exception_ptr error = job.error;
+    job = Job();
+    lock.unlock();
+
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::runItems(std::unique_lock<std::mutex>& lock) {
+    while (job.next < job.count) {
+        size_t i = job.next++;
+        job.active++;
+        const auto* fn = job.fn;
+
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            (*fn)(i);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && (!job.error || i < job.failedIndex)) {
+            job.error = error;
+            job.failedIndex = i;
+        }
+        job.active--;
+    }
+
+    if (job.active == 0) done.notify_all();
+}
+
+void ThreadPool::workerLoop() {
+    insidePool = true;
+    size_t seen = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) return;
+
+        seen = generation;
+        runItems(lock);
+    }
+}
@@ -0,0 +1,73 @@
+# Stress test for pathological nesting. Writes a page to WORK_DIR where
+#   - a chain of DEPTH components each wraps a @load of the next in a @row, so
+#     analysis and rendering go 2 * DEPTH levels deep with a placeholder bound at
+#     the top and read at every level, and
+#   - a screen nests ROWS @rows as written, for the parser and the AST cache,
+# then compiles it twice: once parsing it and writing the .eamlc, once loading the
+# tree back from it. Both pages must be the same and reach the bottom.
+# Run as: cmake -DEAML=... -DWORK_DIR=... [-DDEPTH=10000] [-DROWS=1000] -P deep_nesting.cmake
+# The compiler's timings are printed, so it doubles as a benchmark.
+if(NOT DEPTH)
+    set(DEPTH 10000)
+endif()
+if(NOT ROWS)
+    set(ROWS 1000)
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+# Written out in pieces: appending to one string of the whole page is quadratic
+set(source "${WORK_DIR}/deep.eaml")
+set(page "")
+math(EXPR last "${DEPTH} - 1")
+foreach(i RANGE ${last})
+    string(APPEND page "@save c${i}:\n    @text \"level ${i} {v}\"\n")
+    if(i LESS last)
+        math(EXPR next "${i} + 1")
+        string(APPEND page "    @row:\n        @load c${next}\n")
+    else()
+        string(APPEND page "    @text \"bottom {v}\"\n")
+    endif()
+    string(LENGTH "${page}" size)
+    if(size GREATER 65536)
+        file(APPEND "${source}" "${page}")
+        set(page "")
+    endif()
+endforeach()
+string(APPEND page "@screen chain:\n    @load c0 with:\n        v: \"reached\"\n")
+
+string(APPEND page "@screen nest:\n")
+set(indent "")
+foreach(i RANGE 1 ${ROWS})
+    string(APPEND indent "    ")
+    file(APPEND "${source}" "${page}")
+    set(page "${indent}@row:\n")
+endforeach()
+string(APPEND page "${indent}    @text \"deepest\"\n")
+file(APPEND "${source}" "${page}")
+
+foreach(run parse cached)
+    execute_process(COMMAND "${EAML}" deep.eaml WORKING_DIRECTORY "${WORK_DIR}"
+                    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${run} run failed (${result}):\n${output}")
+    endif()
+    string(REGEX MATCHALL "[^\n]* took [^\n]*" timings "${output}")
+    string(REPLACE ";" "\n  " timings "${timings}")
+    message("${run}:\n  ${timings}")
+    file(RENAME "${WORK_DIR}/output.html" "${WORK_DIR}/${run}.html")
+endforeach()
+
+if(NOT output MATCHES "tree loaded from deep.eamlc")
+    message(FATAL_ERROR "The second run did not load the tree from deep.eamlc")
+endif()
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files parse.html cached.html
+                WORKING_DIRECTORY "${WORK_DIR}" RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "The page from the cached tree differs from the parsed one")
+endif()
+file(READ "${WORK_DIR}/parse.html" html)
+if(NOT html MATCHES "bottom reached" OR NOT html MATCHES "deepest")
+    message(FATAL_ERROR "The page does not reach the bottom of the nesting")
+endif()
@@ -0,0 +1,29 @@
+# Compiles SOURCE both ways in WORK_DIR: to output.html, and with -emit-cpp to a
+# header that DRIVER is built against with CXX. The driver must print the same page.
+# Run as: cmake -DEAML=... -DSOURCE=... -DDRIVER=... -DCXX=... -DWORK_DIR=... -P emit_cpp.cmake
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+function(run)
+    execute_process(COMMAND ${ARGN} WORKING_DIRECTORY "${WORK_DIR}"
+                    RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        string(REPLACE ";" " " command "${ARGN}")
+        message(FATAL_ERROR "${command} failed (${result}):\n${output}")
+    endif()
+endfunction()
+
+run("${EAML}" "${SOURCE}" -no-cache)
+run("${EAML}" "${SOURCE}" -no-cache -emit-cpp page.hpp)
+run("${CXX}" -std=c++17 -Wall -Wextra -Werror -I "${WORK_DIR}" "${DRIVER}" -o driver)
+execute_process(COMMAND "${WORK_DIR}/driver" WORKING_DIRECTORY "${WORK_DIR}"
+                OUTPUT_FILE "${WORK_DIR}/driver.html" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "driver failed (${result})")
+endif()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files output.html driver.html
+                WORKING_DIRECTORY "${WORK_DIR}" RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "The -emit-cpp page differs from ${WORK_DIR}/output.html, see driver.html")
+endif()
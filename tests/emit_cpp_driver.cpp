@@ -0,0 +1,10 @@
+// Prints the page a header written by -emit-cpp renders
+#include "page.hpp"
+#include <cstdio>
+
+int main() {
+    std::string out;
+    eaml::page(out);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
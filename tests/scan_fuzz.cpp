@@ -0,0 +1,94 @@
+// Runs every scan kernel on random inputs and checks each against the scalar one.
+// Inputs end right before a page that can't be read, so a SIMD loop that reads
+// past end crashes the test instead of passing by luck.
+//
+// Usage: scan_fuzz [rounds] [seed]
+#include "scan.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+struct Kernel {
+    const char* name;
+    const char* (*scan::Kernels::*fn)(const char*, const char*);
+};
+
+constexpr Kernel KERNELS[] = {
+    {"stringStop", &scan::Kernels::stringStop},
+    {"lineEnd", &scan::Kernels::lineEnd},
+    {"identEnd", &scan::Kernels::identEnd},
+    {"structural", &scan::Kernels::structural},
+    {"htmlText", &scan::Kernels::htmlText},
+    {"htmlAttribute", &scan::Kernels::htmlAttribute},
+};
+
+// Mostly bytes some kernel stops at, plus identifier characters and the high
+// half, where a signed compare would go wrong
+char randomByte(std::mt19937& rng) {
+    static constexpr char INTERESTING[] = "\"\\\n#<>&'_azAZ09 @";
+    switch (rng() % 4) {
+        case 0: return INTERESTING[rng() % (sizeof INTERESTING - 1)];
+        case 1: return static_cast<char>(0x80 + rng() % 0x80);
+        default: return static_cast<char>(rng() % 0x80);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const unsigned long rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    const unsigned long seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+    constexpr size_t MAX_LENGTH = 300;
+
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t usable = (MAX_LENGTH + pageSize - 1) / pageSize * pageSize;
+    char* region = static_cast<char*>(mmap(nullptr, usable + pageSize, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (region == MAP_FAILED || mprotect(region + usable, pageSize, PROT_NONE) != 0) {
+        std::perror("scan_fuzz: guard page");
+        return 1;
+    }
+    char* const guard = region + usable;
+
+    const scan::Kernels& reference = scan::kernels(scan::Isa::Scalar);
+    int failures = 0;
+    for (scan::Isa isa : {scan::Isa::SSE2, scan::Isa::AVX2}) {
+        const scan::Kernels& tested = scan::kernels(isa);
+        if (tested.isa != isa) {
+            std::printf("%s: not supported here, skipped\n", scan::isaName(isa));
+            continue;
+        }
+
+        std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+        for (unsigned long round = 0; round < rounds && failures < 10; round++) {
+            // Sparse inputs run long enough to go through the wide loops, dense
+            // ones stop early; every start alignment comes up
+            size_t length = rng() % (MAX_LENGTH + 1);
+            char* begin = guard - length;
+            bool sparse = rng() % 2;
+            for (size_t i = 0; i < length; i++)
+                begin[i] = sparse && rng() % 64 ? 'a' : randomByte(rng);
+
+            for (const Kernel& kernel : KERNELS) {
+                for (size_t from = 0; from <= length; from += 1 + rng() % 8) {
+                    const char* want = (reference.*kernel.fn)(begin + from, guard);
+                    const char* got = (tested.*kernel.fn)(begin + from, guard);
+                    if (got != want) {
+                        std::printf("%s %s: stopped at %td instead of %td (length %zu, from %zu, round %lu)\n",
+                                    scan::isaName(isa), kernel.name, got - begin, want - begin, length, from, round);
+                        failures++;
+                    }
+                }
+            }
+        }
+        std::printf("%s: %lu rounds checked\n", scan::isaName(isa), rounds);
+    }
+
+    munmap(region, usable + pageSize);
+    return failures ? 1 : 0;
+}